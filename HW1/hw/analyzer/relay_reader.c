@@ -0,0 +1,248 @@
+/*
+ * reader of the sphw relay channel (lkm/myrelay.ko)
+ *	capture : one thread per cpu splices /sys/kernel/debug/sphw/trace<cpu> into <dir>/cpu<cpu>.bin,
+ *	          records never pass through a userspace buffer. ctrl-c flushes the channel and stops.
+ *	decode  : prints captured files in the /proc/myproc/myproc text format,
+ *	          for trace_analyzer, trace_store, trace_heatmap ('-' input).
+ *
+ * usage : relay_reader [-o dir] [-s subbuf size]
+ *         relay_reader -d cpu0.bin [cpu1.bin...]
+ */
+
+#define _GNU_SOURCE		// splice
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "sphw_trace.h"
+#include "../lkm/sphw_relay.h"
+
+#define DEBUGFS "/sys/kernel/debug"
+#define POLL_MS 100
+
+typedef struct _cpu_reader
+{
+	pthread_t tid;
+	int cpu;
+	int in, out;		// relay file, capture file
+	unsigned long long bytes;
+}cpu_reader;
+
+static volatile sig_atomic_t stop;
+static size_t subbuf_size = 256 * 1024;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+// relay file -> pipe -> capture file, both with splice()
+//	returns bytes moved, 0 if nothing was ready, -1 on error
+static ssize_t splice_once(cpu_reader *r, int pipe_fd[2])
+{
+	ssize_t in, out, done = 0;
+
+	in = splice(r->in, NULL, pipe_fd[1], NULL, subbuf_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (in < 0)
+		return errno == EAGAIN ? 0 : -1;
+
+	while (done < in) {
+		out = splice(pipe_fd[0], NULL, r->out, NULL, in - done, SPLICE_F_MOVE);
+		if (out <= 0)
+			return -1;
+		done += out;
+	}
+
+	return in;
+}
+
+static void *capture_cpu(void *arg)
+{
+	cpu_reader *r = arg;
+	int pipe_fd[2];
+	ssize_t n;
+
+	if (pipe(pipe_fd) < 0) {
+		perror("relay_reader : pipe");
+		return NULL;
+	}
+	fcntl(pipe_fd[1], F_SETPIPE_SZ, subbuf_size);
+
+	while (!stop) {
+		struct pollfd pfd = { r->in, POLLIN, 0 };
+
+		if (poll(&pfd, 1, POLL_MS) <= 0)
+			continue;
+
+		while ((n = splice_once(r, pipe_fd)) > 0)
+			r->bytes += n;
+		if (n < 0) {
+			fprintf(stderr, "relay_reader : cpu %d : %s\n", r->cpu, strerror(errno));
+			break;
+		}
+	}
+
+	// drain what flush made readable
+	while ((n = splice_once(r, pipe_fd)) > 0)
+		r->bytes += n;
+
+	close(pipe_fd[0]);
+	close(pipe_fd[1]);
+
+	return NULL;
+}
+
+static void write_flush(void)
+{
+	int fd = open(DEBUGFS "/" SPHW_RELAY_DIR "/flush", O_WRONLY);
+
+	if (fd >= 0) {
+		if (write(fd, "1", 1) < 0)
+			perror("relay_reader : flush");
+		close(fd);
+	}
+}
+
+static int capture(const char *dir)
+{
+	int n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	cpu_reader *r = calloc(n_cpus, sizeof(*r));
+	unsigned long long total = 0;
+	char path[256];
+	int i, n = 0;
+	FILE *fp;
+
+	mkdir(dir, 0755);
+
+	for (i = 0; i < n_cpus; i++) {
+		snprintf(path, sizeof(path), DEBUGFS "/%s/%s%d", SPHW_RELAY_DIR, SPHW_RELAY_BASE, i);
+		r[n].in = open(path, O_RDONLY);
+		if (r[n].in < 0)
+			continue;		// offline cpu
+
+		snprintf(path, sizeof(path), "%s/cpu%d.bin", dir, i);
+		r[n].out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (r[n].out < 0) {
+			perror(path);
+			return 1;
+		}
+		r[n].cpu = i;
+		n++;
+	}
+	if (n == 0) {
+		fprintf(stderr, "relay_reader : no relay file in " DEBUGFS "/" SPHW_RELAY_DIR
+			", insmod myrelay.ko first\n");
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	for (i = 0; i < n; i++)
+		if (pthread_create(&r[i].tid, NULL, capture_cpu, &r[i])) {
+			perror("relay_reader : pthread_create");
+			return 1;
+		}
+
+	while (!stop)
+		pause();
+
+	// partial sub-buffers become readable after flush
+	write_flush();
+
+	for (i = 0; i < n; i++) {
+		pthread_join(r[i].tid, NULL);
+		close(r[i].in);
+		close(r[i].out);
+		total += r[i].bytes;
+	}
+
+	fprintf(stderr, "relay_reader : %llu records from %d cpus", total / sizeof(struct sphw_bin), n);
+	fp = fopen(DEBUGFS "/" SPHW_RELAY_DIR "/dropped", "r");
+	if (fp) {
+		unsigned long dropped;
+		if (fscanf(fp, "%lu", &dropped) == 1)
+			fprintf(stderr, ", %lu dropped", dropped);
+		fclose(fp);
+	}
+	fprintf(stderr, "\n");
+
+	free(r);
+
+	return 0;
+}
+
+// captured files are plain arrays of struct sphw_bin :
+//	splice() leaves out the padding at the end of each sub-buffer
+static int decode(int argc, char *argv[])
+{
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		sphw_map map;
+		const struct sphw_bin *b, *end;
+
+		if (sphw_map_open(argv[i], &map) < 0) {
+			perror(argv[i]);
+			return 1;
+		}
+
+		b = (const struct sphw_bin *)map.base;
+		end = b + map.len / sizeof(*b);
+		for (; b < end; b++)
+			printf("time : %lld || FS_name : %.*s || block_no : %llu || size : %u || rw : 0x%llx || ns : %llu"
+				" || dev : %u,%u || pid : %u || cpu : %u || class : %s\n",
+				(long long)b->time, SPHW_RELAY_FS_LEN, b->fs_name,
+				(unsigned long long)b->block_no, b->size,
+				(unsigned long long)b->rw, (unsigned long long)b->ns,
+				b->dev >> 20, b->dev & 0xfffff, b->pid, b->cpu, sphw_class_name(b->wclass));
+
+		sphw_map_close(&map);
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : relay_reader [-o dir] [-s subbuf size]\n"
+		"        relay_reader -d cpu0.bin [cpu1.bin...]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir = "relay";
+	int opt, dec = 0;
+
+	while ((opt = getopt(argc, argv, "o:s:d")) != -1) {
+		switch (opt) {
+		case 'o':
+			dir = optarg;
+			break;
+		case 's':
+			subbuf_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dec = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (dec)
+		return optind < argc ? decode(argc - optind, argv + optind) : (usage(), 1);
+	if (optind != argc || subbuf_size == 0)
+		usage();
+
+	return capture(dir);
+}
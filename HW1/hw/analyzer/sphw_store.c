@@ -0,0 +1,338 @@
+/*
+ * columnar sphw trace store
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "sphw_store.h"
+#include "sphw_varint.h"
+
+// last sector written by a record
+static inline uint64_t last_sector(uint64_t sector, uint64_t size)
+{
+	return size >= 512 ? sector + (size >> 9) - 1 : sector;
+}
+
+int sphw_store_create(store_writer *w, const char *path)
+{
+	memset(w, 0, sizeof(*w));
+
+	w->fp = fopen(path, "wb");
+	if (!w->fp)
+		return -1;
+
+	w->buf = malloc(STORE_COLS * STORE_BLOCK * VARINT_MAX);
+	w->cap = 1024;
+	w->index = malloc(w->cap * sizeof(*w->index));
+	if (!w->buf || !w->index ||
+	    fwrite(STORE_MAGIC, STORE_MAGIC_LEN, 1, w->fp) != 1) {
+		fclose(w->fp);
+		free(w->buf);
+		free(w->index);
+		return -1;
+	}
+	w->offset = STORE_MAGIC_LEN;
+
+	return 0;
+}
+
+// encode the buffered records as one block
+static int flush_block(store_writer *w)
+{
+	uint32_t col_len[STORE_COLS];
+	uint8_t *p = w->buf;
+	int c;
+	uint32_t i;
+
+	if (w->n == 0)
+		return 0;
+
+	for (c = 0; c < STORE_COLS; c++) {
+		uint8_t *start = p;
+		uint64_t prev = 0;
+
+		for (i = 0; i < w->n; i++) {
+			p = put_varint(p, zigzag((int64_t)(w->col[c][i] - prev)));
+			prev = w->col[c][i];
+		}
+		col_len[c] = p - start;
+	}
+
+	if (fwrite(col_len, sizeof(col_len), 1, w->fp) != 1 ||
+	    fwrite(w->buf, p - w->buf, 1, w->fp) != 1)
+		return -1;
+
+	w->cur.offset = w->offset;
+	w->cur.len = sizeof(col_len) + (p - w->buf);
+	w->cur.nrec = w->n;
+	w->offset += w->cur.len;
+
+	if (w->nblocks == w->cap) {
+		store_index *ni = realloc(w->index, w->cap * 2 * sizeof(*ni));
+		if (!ni)
+			return -1;
+		w->index = ni;
+		w->cap *= 2;
+	}
+	w->index[w->nblocks++] = w->cur;
+	w->n = 0;
+
+	return 0;
+}
+
+static int writer_fs_id(store_writer *w, const char *name, int len)
+{
+	int i;
+
+	if (len >= FS_NAME_MAX)
+		len = FS_NAME_MAX - 1;
+
+	for (i = 0; i < w->nfs; i++)
+		if (!strncmp(w->fs[i], name, len) && w->fs[i][len] == '\0')
+			return i;
+
+	// too many file systems : the rest share the last id
+	if (w->nfs == STORE_FS_MAX)
+		return STORE_FS_MAX - 1;
+
+	memcpy(w->fs[i], name, len);
+	w->fs[i][len] = '\0';
+	w->nfs++;
+
+	return i;
+}
+
+int sphw_store_append(store_writer *w, const sphw_rec *rec)
+{
+	store_index *ix = &w->cur;
+	uint64_t end = last_sector(rec->block_no, rec->size);
+	int id = writer_fs_id(w, rec->fs_name, rec->fs_len);
+	uint32_t n = w->n;
+
+	if (n == 0) {
+		memset(ix, 0, sizeof(*ix));
+		ix->min_time = ix->max_time = rec->time;
+		ix->min_ns = ix->max_ns = rec->ns;
+		ix->min_sector = rec->block_no;
+		ix->max_sector = end;
+	} else {
+		if (rec->time < ix->min_time)
+			ix->min_time = rec->time;
+		if (rec->time > ix->max_time)
+			ix->max_time = rec->time;
+		if (rec->ns < ix->min_ns)
+			ix->min_ns = rec->ns;
+		if (rec->ns > ix->max_ns)
+			ix->max_ns = rec->ns;
+		if (rec->block_no < ix->min_sector)
+			ix->min_sector = rec->block_no;
+		if (end > ix->max_sector)
+			ix->max_sector = end;
+	}
+	ix->rw_or |= rec->rw;
+	ix->fs_mask |= 1U << id;
+
+	w->col[COL_TIME][n] = rec->time;
+	w->col[COL_NS][n] = rec->ns;
+	w->col[COL_SECTOR][n] = rec->block_no;
+	w->col[COL_SIZE][n] = rec->size;
+	w->col[COL_RW][n] = rec->rw;
+	w->col[COL_FS][n] = id;
+
+	if (++w->n == STORE_BLOCK)
+		return flush_block(w);
+
+	return 0;
+}
+
+int sphw_store_finish(store_writer *w)
+{
+	uint32_t hdr[2] = { w->nfs, 0 };
+	uint64_t footer, pad = 0;
+	int ret = 0;
+
+	if (flush_block(w) < 0)
+		ret = -1;
+
+	// footer starts at an 8-byte boundary so that the index can be used in place
+	if (w->offset % 8) {
+		fwrite(&pad, 8 - w->offset % 8, 1, w->fp);
+		w->offset += 8 - w->offset % 8;
+	}
+	footer = w->offset;
+
+	if (fwrite(hdr, sizeof(hdr), 1, w->fp) != 1 ||
+	    (w->nfs && fwrite(w->fs, FS_NAME_MAX, w->nfs, w->fp) != (size_t)w->nfs) ||
+	    fwrite(&w->nblocks, sizeof(w->nblocks), 1, w->fp) != 1 ||
+	    (w->nblocks && fwrite(w->index, sizeof(*w->index), w->nblocks, w->fp) != w->nblocks) ||
+	    fwrite(&footer, sizeof(footer), 1, w->fp) != 1 ||
+	    fwrite(STORE_MAGIC, STORE_MAGIC_LEN, 1, w->fp) != 1)
+		ret = -1;
+
+	if (fclose(w->fp))
+		ret = -1;
+	free(w->buf);
+	free(w->index);
+
+	return ret;
+}
+
+int sphw_store_open(store_reader *r, const char *path)
+{
+	const char *base, *end, *p;
+	uint64_t footer;
+
+	if (sphw_map_open(path, &r->map) < 0)
+		return -1;
+
+	base = r->map.base;
+	end = base + r->map.len;
+
+	if (r->map.len < 2 * STORE_MAGIC_LEN + sizeof(footer) ||
+	    memcmp(base, STORE_MAGIC, STORE_MAGIC_LEN) ||
+	    memcmp(end - STORE_MAGIC_LEN, STORE_MAGIC, STORE_MAGIC_LEN))
+		goto corrupted;
+
+	memcpy(&footer, end - STORE_MAGIC_LEN - sizeof(footer), sizeof(footer));
+	if (footer % 8 || footer + 16 > r->map.len)
+		goto corrupted;
+
+	p = base + footer;
+	if (*(const uint32_t *)p > STORE_FS_MAX)
+		goto corrupted;
+	r->nfs = *(const uint32_t *)p;
+	p += 8;
+	r->fs = (const char (*)[FS_NAME_MAX])p;
+	p += (uint64_t)r->nfs * FS_NAME_MAX;
+	if (p + 8 > end)
+		goto corrupted;
+
+	r->nblocks = *(const uint64_t *)p;
+	p += 8;
+	r->index = (const store_index *)p;
+	if (r->nblocks > (uint64_t)(end - p) / sizeof(store_index))
+		goto corrupted;
+
+	return 0;
+
+corrupted:
+	sphw_map_close(&r->map);
+	return -1;
+}
+
+void sphw_store_close(store_reader *r)
+{
+	sphw_map_close(&r->map);
+}
+
+void sphw_store_query_init(store_query *q)
+{
+	q->t_from = INT64_MIN;
+	q->t_to = INT64_MAX;
+	q->lba_from = 0;
+	q->lba_to = UINT64_MAX;
+	q->rw_mask = 0;
+	q->fs_id = -1;
+}
+
+int sphw_store_fs_id(const store_reader *r, const char *name)
+{
+	int i;
+
+	for (i = 0; i < r->nfs; i++)
+		if (!strncmp(r->fs[i], name, FS_NAME_MAX))
+			return i;
+
+	return -1;
+}
+
+int sphw_store_block_match(const store_reader *r, uint64_t i, const store_query *q)
+{
+	const store_index *ix = &r->index[i];
+
+	return ix->max_time >= q->t_from && ix->min_time <= q->t_to &&
+		ix->max_sector >= q->lba_from && ix->min_sector <= q->lba_to &&
+		(ix->rw_or & q->rw_mask) == q->rw_mask &&
+		(q->fs_id < 0 || (ix->fs_mask & (1U << q->fs_id)));
+}
+
+// decode one column of nrec values, returns the end of the column or NULL
+static const uint8_t *decode_col(const uint8_t *p, const uint8_t *end, uint32_t nrec, uint64_t *out)
+{
+	uint64_t prev = 0, v;
+	uint32_t i;
+
+	for (i = 0; i < nrec; i++) {
+		p = get_varint(p, end, &v);
+		if (!p)
+			return NULL;
+		prev += (uint64_t)unzigzag(v);
+		out[i] = prev;
+	}
+
+	return p;
+}
+
+long long sphw_store_query(const store_reader *r, const store_query *q, sphw_rec_fn fn, void *arg)
+{
+	static __thread uint64_t col[STORE_COLS][STORE_BLOCK];
+	long long n = 0;
+	uint64_t b;
+
+	for (b = 0; b < r->nblocks; b++) {
+		const store_index *ix = &r->index[b];
+		const uint8_t *p, *end;
+		uint32_t col_len[STORE_COLS];
+		uint32_t i;
+		int c;
+
+		if (!sphw_store_block_match(r, b, q))
+			continue;
+
+		if (ix->nrec > STORE_BLOCK || ix->offset + ix->len > r->map.len || ix->len < sizeof(col_len))
+			return -1;
+
+		p = (const uint8_t *)r->map.base + ix->offset;
+		end = p + ix->len;
+		memcpy(col_len, p, sizeof(col_len));
+		p += sizeof(col_len);
+
+		for (c = 0; c < STORE_COLS; c++) {
+			if (col_len[c] > (uint64_t)(end - p) || !decode_col(p, p + col_len[c], ix->nrec, col[c]))
+				return -1;
+			p += col_len[c];
+		}
+
+		for (i = 0; i < ix->nrec; i++) {
+			sphw_rec rec;
+			uint64_t id = col[COL_FS][i];	// unsigned : a corrupt block can't index below r->fs
+
+			// the store has no dev, pid, cpu and class columns
+			memset(&rec, 0, sizeof(rec));
+			rec.wclass = -1;
+
+			rec.time = col[COL_TIME][i];
+			rec.ns = col[COL_NS][i];
+			rec.block_no = col[COL_SECTOR][i];
+			rec.size = col[COL_SIZE][i];
+			rec.rw = col[COL_RW][i];
+
+			if (rec.time < q->t_from || rec.time > q->t_to ||
+			    last_sector(rec.block_no, rec.size) < q->lba_from || rec.block_no > q->lba_to ||
+			    (rec.rw & q->rw_mask) != q->rw_mask ||
+			    (q->fs_id >= 0 && id != (uint64_t)q->fs_id))
+				continue;
+
+			rec.fs_name = id < (uint64_t)r->nfs ? r->fs[id] : "";
+			rec.fs_len = strnlen(rec.fs_name, FS_NAME_MAX);
+
+			n++;
+			if (fn(&rec, arg))
+				return n;
+		}
+	}
+
+	return n;
+}
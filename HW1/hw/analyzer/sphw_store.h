@@ -0,0 +1,110 @@
+/*
+ * columnar sphw trace store
+ *	records are grouped into blocks of STORE_BLOCK records,
+ *	each column (time, ns, sector, size, rw, fs) of a block is delta + zigzag + varint coded.
+ *	the footer keeps a sparse index : time / ns / sector range and flags of every block,
+ *	so a query reads only the blocks that can match.
+ *
+ *	file : "SPHWCOL1" | block | block | ... | footer | trailer
+ *	block : uint32_t col_len[STORE_COLS] | column | column | ...
+ *	footer : uint32_t nfs, pad | char fs[nfs][FS_NAME_MAX] | uint64_t nblocks | store_index[nblocks]
+ *	trailer : uint64_t footer offset | "SPHWCOL1"
+ */
+
+#ifndef _SPHW_STORE_H
+#define _SPHW_STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sphw_trace.h"
+
+#define STORE_MAGIC "SPHWCOL1"
+#define STORE_MAGIC_LEN 8
+#define STORE_BLOCK 4096		// records per block
+#define STORE_FS_MAX 16			// file system names per store
+
+// columns of a block
+enum
+{
+	COL_TIME,
+	COL_NS,
+	COL_SECTOR,
+	COL_SIZE,
+	COL_RW,
+	COL_FS,
+	STORE_COLS
+};
+
+// index entry of one block
+typedef struct _store_index
+{
+	int64_t min_time, max_time;		// wall time (s)
+	uint64_t min_ns, max_ns;		// monotonic time (ns)
+	uint64_t min_sector, max_sector;	// max_sector is the last sector written
+	uint64_t rw_or;					// OR of the flags of all records
+	uint64_t offset;				// file offset of the block
+	uint32_t len;					// bytes of the block
+	uint32_t nrec;					// records in the block
+	uint32_t fs_mask;				// bit i set if fs i appears
+	uint32_t pad;
+}store_index;
+
+typedef struct _store_writer
+{
+	FILE *fp;
+	uint64_t offset;
+
+	int nfs;
+	char fs[STORE_FS_MAX][FS_NAME_MAX];
+
+	// records of the current block
+	uint32_t n;
+	uint64_t col[STORE_COLS][STORE_BLOCK];
+	store_index cur;
+
+	store_index *index;
+	uint64_t nblocks, cap;
+
+	uint8_t *buf;		// encoded block
+}store_writer;
+
+typedef struct _store_reader
+{
+	sphw_map map;
+	int nfs;
+	const char (*fs)[FS_NAME_MAX];
+	uint64_t nblocks;
+	const store_index *index;
+}store_reader;
+
+// filter of a query, ranges are inclusive
+typedef struct _store_query
+{
+	int64_t t_from, t_to;			// wall time (s)
+	uint64_t lba_from, lba_to;		// sectors
+	uint64_t rw_mask;				// keep records with all these flags
+	int fs_id;						// -1 : all file systems
+}store_query;
+
+int sphw_store_create(store_writer *w, const char *path);
+int sphw_store_append(store_writer *w, const sphw_rec *rec);
+int sphw_store_finish(store_writer *w);
+
+int sphw_store_open(store_reader *r, const char *path);
+void sphw_store_close(store_reader *r);
+
+// query matching everything
+void sphw_store_query_init(store_query *q);
+
+// id of a file system name in the store, -1 if absent
+int sphw_store_fs_id(const store_reader *r, const char *name);
+
+// can block i contain records matching q
+int sphw_store_block_match(const store_reader *r, uint64_t i, const store_query *q);
+
+// call fn for every record matching q, returns the number of matching records
+//	-1 if the store is corrupted
+long long sphw_store_query(const store_reader *r, const store_query *q, sphw_rec_fn fn, void *arg);
+
+#endif
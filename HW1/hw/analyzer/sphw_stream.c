@@ -0,0 +1,255 @@
+/*
+ * streaming sphw trace encoding
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sphw_stream.h"
+#include "sphw_varint.h"
+
+#define FRAME_HDR 8
+#define REC_MAX (1 + 7 * VARINT_MAX + FS_NAME_MAX)	// longest encoded record
+
+// mask bits : field differs from the previous record
+#define CH_FS		(1 << 0)
+#define CH_SIZE		(1 << 1)
+#define CH_RW		(1 << 2)
+#define CH_DEV		(1 << 3)
+#define CH_PID		(1 << 4)
+#define CH_CPU		(1 << 5)
+#define CH_CLASS	(1 << 6)
+#define CH_ALL		0x7f
+
+// sector right after a record : where the next sequential write starts
+static inline uint64_t next_sector(const sphw_rec *rec)
+{
+	return rec->block_no + (rec->size >> 9);
+}
+
+int sphw_stream_create(stream_writer *w, FILE *fp)
+{
+	memset(w, 0, sizeof(*w));
+
+	w->fp = fp;
+	w->buf = malloc(FRAME_HDR + STREAM_FRAME * REC_MAX);
+	if (!w->buf)
+		return -1;
+	w->p = w->buf + FRAME_HDR;
+
+	if (fwrite(STREAM_MAGIC, STREAM_MAGIC_LEN, 1, fp) != 1)
+		return -1;
+	w->bytes = STREAM_MAGIC_LEN;
+
+	return 0;
+}
+
+static int flush_frame(stream_writer *w)
+{
+	uint32_t hdr[2];
+	size_t len = w->p - w->buf;
+
+	if (w->n == 0)
+		return 0;
+
+	hdr[0] = len - FRAME_HDR;
+	hdr[1] = w->n;
+	memcpy(w->buf, hdr, FRAME_HDR);
+	if (fwrite(w->buf, len, 1, w->fp) != 1 || fflush(w->fp))
+		return -1;
+
+	w->bytes += len;
+	w->p = w->buf + FRAME_HDR;
+	w->n = 0;
+
+	return 0;
+}
+
+int sphw_stream_append(stream_writer *w, const sphw_rec *rec)
+{
+	const sphw_rec *prev = &w->prev;
+	int fs_len = rec->fs_len < FS_NAME_MAX ? rec->fs_len : FS_NAME_MAX - 1;
+	uint8_t *p = w->p;
+	uint8_t mask = CH_ALL;
+
+	// first record of a frame : everything is coded against zeros
+	if (w->n == 0) {
+		memset(&w->prev, 0, sizeof(w->prev));
+		w->fs[0] = '\0';
+	} else {
+		mask = 0;
+		if (strncmp(w->fs, rec->fs_name, fs_len) || w->fs[fs_len])
+			mask |= CH_FS;
+		if (rec->size != prev->size)
+			mask |= CH_SIZE;
+		if (rec->rw != prev->rw)
+			mask |= CH_RW;
+		if (rec->dev != prev->dev)
+			mask |= CH_DEV;
+		if (rec->pid != prev->pid)
+			mask |= CH_PID;
+		if (rec->cpu != prev->cpu)
+			mask |= CH_CPU;
+		if (rec->wclass != prev->wclass)
+			mask |= CH_CLASS;
+	}
+
+	*p++ = mask;
+	p = put_varint(p, zigzag((int64_t)(rec->ns - prev->ns)));
+	p = put_varint(p, zigzag((int64_t)rec->time - prev->time));
+	p = put_varint(p, zigzag((int64_t)(rec->block_no - next_sector(prev))));
+	if (mask & CH_FS) {
+		*p++ = fs_len;
+		memcpy(p, rec->fs_name, fs_len);
+		p += fs_len;
+		memcpy(w->fs, rec->fs_name, fs_len);
+		w->fs[fs_len] = '\0';
+	}
+	if (mask & CH_SIZE)
+		p = put_varint(p, rec->size);
+	if (mask & CH_RW)
+		p = put_varint(p, rec->rw);
+	if (mask & CH_DEV)
+		p = put_varint(p, rec->dev);
+	if (mask & CH_PID)
+		p = put_varint(p, (uint32_t)rec->pid);
+	if (mask & CH_CPU)
+		p = put_varint(p, (uint32_t)rec->cpu);
+	if (mask & CH_CLASS)
+		p = put_varint(p, zigzag(rec->wclass));
+
+	w->p = p;
+	w->prev = *rec;
+	w->records++;
+
+	if (++w->n == STREAM_FRAME)
+		return flush_frame(w);
+
+	return 0;
+}
+
+int sphw_stream_finish(stream_writer *w)
+{
+	int ret = flush_frame(w);
+
+	free(w->buf);
+
+	return ret;
+}
+
+int sphw_stream_is(const char *base, size_t len)
+{
+	return len >= STREAM_MAGIC_LEN && !memcmp(base, STREAM_MAGIC, STREAM_MAGIC_LEN);
+}
+
+void sphw_stream_split(const char *base, size_t len, int n, size_t *bounds)
+{
+	size_t off = STREAM_MAGIC_LEN;
+	int i;
+
+	bounds[0] = off;
+	for (i = 1; i < n; i++) {
+		size_t target = len / n * i;
+
+		// walk frame headers up to the target offset
+		while (off + FRAME_HDR <= len && off < target) {
+			uint32_t flen;
+
+			memcpy(&flen, base + off, sizeof(flen));
+			if (off + FRAME_HDR + flen > len)
+				break;
+			off += FRAME_HDR + flen;
+		}
+		bounds[i] = off;
+	}
+	bounds[n] = len;
+}
+
+static const uint8_t *decode_frame(const uint8_t *p, const uint8_t *end, uint32_t nrec,
+	sphw_rec_fn fn, void *arg, int *stop)
+{
+	sphw_rec rec;
+	uint64_t v;
+	uint32_t i;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.fs_name = "";
+
+	for (i = 0; i < nrec; i++) {
+		uint8_t mask;
+
+		if (p >= end)
+			return NULL;
+		mask = *p++;
+
+		if (!(p = get_varint(p, end, &v)))
+			return NULL;
+		rec.ns += unzigzag(v);
+		if (!(p = get_varint(p, end, &v)))
+			return NULL;
+		rec.time += unzigzag(v);
+		if (!(p = get_varint(p, end, &v)))
+			return NULL;
+		rec.block_no = next_sector(&rec) + unzigzag(v);
+
+		if (mask & CH_FS) {
+			if (p >= end || *p >= FS_NAME_MAX || p + 1 + *p > end)
+				return NULL;
+			rec.fs_len = *p;
+			rec.fs_name = (const char *)p + 1;
+			p += 1 + rec.fs_len;
+		}
+
+#define GET_FIELD(bit, expr) \
+		if (mask & (bit)) { \
+			if (!(p = get_varint(p, end, &v))) \
+				return NULL; \
+			expr; \
+		}
+
+		GET_FIELD(CH_SIZE, rec.size = v)
+		GET_FIELD(CH_RW, rec.rw = v)
+		GET_FIELD(CH_DEV, rec.dev = v)
+		GET_FIELD(CH_PID, rec.pid = v)
+		GET_FIELD(CH_CPU, rec.cpu = v)
+		GET_FIELD(CH_CLASS, rec.wclass = unzigzag(v))
+#undef GET_FIELD
+
+		// readers index tables with these
+		if (rec.cpu < 0 || rec.cpu >= SPHW_CPU_MAX || rec.wclass < -1 || rec.wclass >= SPHW_CLASSES)
+			return NULL;
+
+		if (fn(&rec, arg)) {
+			*stop = 1;
+			break;
+		}
+	}
+
+	return p;
+}
+
+long long sphw_stream_scan(const char *begin, const char *end, sphw_rec_fn fn, void *arg)
+{
+	const uint8_t *p = (const uint8_t *)begin;
+	const uint8_t *e = (const uint8_t *)end;
+	long long n = 0;
+	int stop = 0;
+
+	while (!stop && p + FRAME_HDR <= e) {
+		uint32_t hdr[2];
+		const uint8_t *frame_end;
+
+		memcpy(hdr, p, FRAME_HDR);
+		p += FRAME_HDR;
+		if (hdr[0] > (size_t)(e - p))
+			break;		// truncated : the collector was killed while writing it
+		frame_end = p + hdr[0];
+
+		if (decode_frame(p, frame_end, hdr[1], fn, arg, &stop) == NULL)
+			return -1;
+		n += hdr[1];
+		p = frame_end;
+	}
+
+	return n;
+}
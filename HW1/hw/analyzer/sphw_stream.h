@@ -0,0 +1,53 @@
+/*
+ * streaming sphw trace encoding
+ *	row oriented and append only, for the collector : records are encoded as they come
+ *	and written one frame at a time, a killed collector loses the last frame only.
+ *	each record is coded against the previous one of its frame :
+ *		mask byte : which of fs, size, rw, dev, pid, cpu, class changed
+ *		ns, time : zigzag delta
+ *		sector : zigzag delta from the end of the previous record, 0 for a sequential write
+ *		changed fields : varint (fs : length + name)
+ *	frames are independent, so a reader can split a file at frame boundaries.
+ *
+ *	file : "SPHWSTR1" | frame | frame | ...
+ *	frame : uint32_t len, uint32_t nrec | records (len bytes)
+ */
+
+#ifndef _SPHW_STREAM_H
+#define _SPHW_STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sphw_trace.h"
+
+#define STREAM_MAGIC "SPHWSTR1"
+#define STREAM_MAGIC_LEN 8
+#define STREAM_FRAME 4096		// records per frame
+
+typedef struct _stream_writer
+{
+	FILE *fp;
+	uint32_t n;				// records in the current frame
+	uint8_t *buf, *p;		// current frame
+	sphw_rec prev;			// previous record of the frame
+	char fs[FS_NAME_MAX];	// fs_name of prev
+	unsigned long long records, bytes;
+}stream_writer;
+
+// fp is left open by sphw_stream_finish()
+int sphw_stream_create(stream_writer *w, FILE *fp);
+int sphw_stream_append(stream_writer *w, const sphw_rec *rec);
+int sphw_stream_finish(stream_writer *w);
+
+// 1 if [base, base+len) starts with STREAM_MAGIC
+int sphw_stream_is(const char *base, size_t len);
+
+// split the frames of a mapped stream file into n chunks, like sphw_split()
+void sphw_stream_split(const char *base, size_t len, int n, size_t *bounds);
+
+// decode the frames in [p, end), returns records decoded or -1 if a frame is corrupted
+//	a truncated last frame is ignored
+long long sphw_stream_scan(const char *p, const char *end, sphw_rec_fn fn, void *arg);
+
+#endif
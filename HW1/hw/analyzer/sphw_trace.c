@@ -0,0 +1,334 @@
+/*
+ * sphw trace reader
+ */
+
+#define _GNU_SOURCE		// memrchr
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sphw_trace.h"
+
+#define READ_BUFSIZE (1 << 20)	// read size of sphw_scan_fd
+
+// map the whole trace file read-only
+int sphw_map_open(const char *path, sphw_map *map)
+{
+	struct stat st;
+
+	map->fd = open(path, O_RDONLY);
+	if (map->fd < 0)
+		return -1;
+
+	if (fstat(map->fd, &st) < 0) {
+		close(map->fd);
+		return -1;
+	}
+
+	map->len = st.st_size;
+	map->base = NULL;
+	if (map->len == 0)
+		return 0;
+
+	map->base = mmap(NULL, map->len, PROT_READ, MAP_PRIVATE, map->fd, 0);
+	if (map->base == MAP_FAILED) {
+		close(map->fd);
+		return -1;
+	}
+
+	// whole file is scanned front to back once
+	//	advice values are not flags : one call each
+	madvise((void *)map->base, map->len, MADV_SEQUENTIAL);
+	madvise((void *)map->base, map->len, MADV_WILLNEED);
+
+	return 0;
+}
+
+void sphw_map_close(sphw_map *map)
+{
+	if (map->base)
+		munmap((void *)map->base, map->len);
+	close(map->fd);
+}
+
+void sphw_split(const char *base, size_t len, int n, size_t *bounds)
+{
+	int i;
+
+	bounds[0] = 0;
+	for (i = 1; i < n; i++) {
+		size_t off = len / n * i;
+		const char *nl;
+
+		if (off < bounds[i-1])
+			off = bounds[i-1];
+
+		// move the cut right after the next '\n'
+		nl = memchr(base + off, '\n', len - off);
+		bounds[i] = nl ? (size_t)(nl - base) + 1 : len;
+	}
+	bounds[n] = len;
+}
+
+// skip '\0' padding, spaces and newlines between records
+//	padding is about 40 bytes per record : test 16 bytes at once
+static inline const char *skip_pad(const char *p, const char *end)
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i nl = _mm_set1_epi8('\n');
+
+	while (p + 16 <= end) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		__m128i pad = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, zero),
+			_mm_cmpeq_epi8(v, space)), _mm_cmpeq_epi8(v, nl));
+		unsigned int mask = _mm_movemask_epi8(pad);
+
+		if (mask != 0xffff)
+			return p + __builtin_ctz(~mask);
+		p += 16;
+	}
+#endif
+	while (p < end && (*p == '\0' || *p == ' ' || *p == '\n'))
+		p++;
+
+	return p;
+}
+
+static inline unsigned long long parse_u64(const char *p, const char *end)
+{
+	unsigned long long v = 0;
+
+	while (p < end && *p >= '0' && *p <= '9')
+		v = v * 10 + (*p++ - '0');
+
+	return v;
+}
+
+// "0x..."
+static inline unsigned long long parse_hex(const char *p, const char *end)
+{
+	unsigned long long v = 0;
+
+	if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+		p += 2;
+
+	for (; p < end; p++) {
+		if (*p >= '0' && *p <= '9')
+			v = v * 16 + (*p - '0');
+		else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f')
+			v = v * 16 + ((*p | 0x20) - 'a' + 10);
+		else
+			break;
+	}
+
+	return v;
+}
+
+static const char *class_names[SPHW_CLASSES] = { "data", "node", "meta", "gc", "journal" };
+
+const char *sphw_class_name(int wclass)
+{
+	return wclass >= 0 && wclass < SPHW_CLASSES ? class_names[wclass] : "-";
+}
+
+static int parse_class(const char *p, const char *end)
+{
+	int i;
+
+	for (i = 0; i < SPHW_CLASSES; i++)
+		if (end - p == (long)strlen(class_names[i]) && !memcmp(p, class_names[i], end - p))
+			return i;
+
+	return -1;
+}
+
+// "key : value || key : value || ..."
+int sphw_parse_line(const char *p, const char *end, sphw_rec *rec)
+{
+	int has_time = 0, has_block = 0, bad = 0;
+
+	rec->fs_name = "";
+	rec->fs_len = 0;
+	rec->size = 0;
+	rec->rw = 0;
+	rec->ns = 0;
+	rec->dev = 0;
+	rec->pid = 0;
+	rec->cpu = 0;
+	rec->wclass = -1;
+
+	while (p < end) {
+		const char *key = p;
+		const char *colon, *val, *bar, *vend;
+		int klen;
+
+		colon = memchr(p, ':', end - p);
+		if (!colon)
+			break;
+
+		klen = colon - key;
+		while (klen > 0 && key[klen-1] == ' ')
+			klen--;
+
+		val = colon + 1;
+		while (val < end && *val == ' ')
+			val++;
+
+		bar = val < end ? memchr(val, '|', end - val) : NULL;
+		vend = bar ? bar : end;
+		while (vend > val && vend[-1] == ' ')
+			vend--;
+
+		switch (klen) {
+		case 2:		// rw, ns
+			if (!memcmp(key, "rw", 2))
+				rec->rw = parse_hex(val, vend);
+			else if (!memcmp(key, "ns", 2))
+				rec->ns = parse_u64(val, vend);
+			break;
+		case 3:		// dev, pid, cpu
+			if (!memcmp(key, "dev", 3)) {
+				const char *comma = memchr(val, ',', vend - val);
+				if (comma)
+					rec->dev = parse_u64(val, comma) << 20 | parse_u64(comma + 1, vend);
+			} else if (!memcmp(key, "pid", 3)) {
+				rec->pid = parse_u64(val, vend);
+			} else if (!memcmp(key, "cpu", 3)) {
+				// tools keep tables per cpu : a garbage cpu is no record
+				unsigned long long cpu = parse_u64(val, vend);
+				if (cpu >= SPHW_CPU_MAX)
+					bad = 1;
+				else
+					rec->cpu = cpu;
+			}
+			break;
+		case 4:		// time, size
+			if (!memcmp(key, "time", 4)) {
+				rec->time = parse_u64(val, vend);
+				has_time = 1;
+			} else if (!memcmp(key, "size", 4)) {
+				rec->size = parse_u64(val, vend);
+			}
+			break;
+		case 5:		// class
+			if (!memcmp(key, "class", 5))
+				rec->wclass = parse_class(val, vend);
+			break;
+		case 7:		// FS_name
+			if (!memcmp(key, "FS_name", 7)) {
+				rec->fs_name = val;
+				rec->fs_len = vend - val < FS_NAME_MAX ? vend - val : FS_NAME_MAX - 1;
+			}
+			break;
+		case 8:		// block_no
+			if (!memcmp(key, "block_no", 8)) {
+				rec->block_no = parse_u64(val, vend);
+				has_block = 1;
+			}
+			break;
+		}
+
+		if (!bar)
+			break;
+		p = bar + 2;	// skip "||"
+		while (p < end && *p == ' ')
+			p++;
+	}
+
+	return has_time && has_block && !bad;
+}
+
+unsigned long long sphw_scan(const char *p, const char *end, sphw_rec_fn fn, void *arg)
+{
+	unsigned long long n = 0;
+	sphw_rec rec;
+
+	while ((p = skip_pad(p, end)) < end) {
+		const char *nl = memchr(p, '\n', end - p);
+		const char *eol = nl ? nl : end;
+
+		// a line may be cut by '\0' when the dump was truncated
+		const char *nul = memchr(p, '\0', eol - p);
+		if (nul)
+			eol = nul;
+
+		if (sphw_parse_line(p, eol, &rec)) {
+			n++;
+			if (fn(&rec, arg))
+				break;
+		}
+
+		p = eol;
+	}
+
+	return n;
+}
+
+// stop flag of sphw_scan_fd, set when fn asks to stop
+typedef struct _fd_scan
+{
+	sphw_rec_fn fn;
+	void *arg;
+	int stop;
+}fd_scan;
+
+static int fd_scan_rec(const sphw_rec *rec, void *arg)
+{
+	fd_scan *s = arg;
+
+	s->stop = s->fn(rec, s->arg);
+	return s->stop;
+}
+
+unsigned long long sphw_scan_fd(int fd, sphw_rec_fn fn, void *arg)
+{
+	unsigned long long n = 0;
+	size_t cap = READ_BUFSIZE, len = 0;
+	char *buf = malloc(cap);
+	fd_scan s = { fn, arg, 0 };
+	ssize_t r;
+
+	if (!buf)
+		return 0;
+
+	// scan complete lines, keep the last partial line for the next read
+	while (!s.stop && (r = read(fd, buf + len, cap - len)) > 0) {
+		char *nl;
+
+		len += r;
+		nl = memrchr(buf, '\n', len);
+		if (!nl) {
+			// one line is longer than the buffer
+			if (len == cap) {
+				char *nbuf = realloc(buf, cap * 2);
+				if (!nbuf)
+					break;
+				buf = nbuf;
+				cap *= 2;
+			}
+			continue;
+		}
+
+		n += sphw_scan(buf, nl + 1, fd_scan_rec, &s);
+		len -= nl + 1 - buf;
+		memmove(buf, nl + 1, len);
+	}
+
+	if (!s.stop && len > 0)
+		n += sphw_scan(buf, buf + len, fd_scan_rec, &s);
+
+	free(buf);
+
+	return n;
+}
@@ -0,0 +1,84 @@
+/*
+ * sphw trace reader
+ *	parses the records dumped from /proc/myproc/myproc
+ *	"time : 1603965487 || FS_name : ext4 || block_no : 36814848 || size : 4096 || rw : 0x1 || ns : ...
+ *	 || dev : 8,16 || pid : 1234 || cpu : 0 || class : data\n"
+ *	size, rw, ns, dev, pid and cpu are missing in older dumps, they are 0 then, class is -1
+ *	myproc.c writes one '\n' terminated line per record, unpadded, and a "lost : N" line
+ *	where records were overwritten before they were read (no block_no : not a record).
+ *	older dumps (raw/ext4_result.txt, raw/f2fs_result.txt) pad every record with '\0', padding is skipped.
+ */
+
+#ifndef _SPHW_TRACE_H
+#define _SPHW_TRACE_H
+
+#include <stddef.h>
+
+#define FS_NAME_MAX 16
+#define SPHW_CPU_MAX 4096		// cpu fields from here up are taken as corrupt
+
+// bio flags (rw) of linux 4.4, include/linux/blk_types.h
+#define REQ_WRITE	(1UL << 0)
+#define REQ_SYNC	(1UL << 4)
+#define REQ_META	(1UL << 5)
+#define REQ_DISCARD	(1UL << 7)
+#define REQ_FUA		(1UL << 12)
+#define REQ_FLUSH	(1UL << 13)
+
+// write classes, same order as in kernel (blk-core.c)
+#define SPHW_DATA 0
+#define SPHW_NODE 1
+#define SPHW_META 2
+#define SPHW_GC 3
+#define SPHW_JOURNAL 4
+#define SPHW_CLASSES 5
+
+// one parsed record
+//	fs_name points into the mapped file, it's not terminated
+typedef struct _sphw_rec
+{
+	const char *fs_name;			// file system name : ext4 / f2fs
+	int fs_len;						// length of fs_name
+	long time;						// write time
+	unsigned long long block_no;	// block number
+	unsigned int size;				// bio size (bytes)
+	unsigned long rw;				// bio flags
+	unsigned long long ns;			// write time, monotonic (ns)
+	unsigned int dev;				// device, major << 20 | minor
+	int pid;						// submitting process
+	int cpu;						// submitting cpu
+	int wclass;						// write class, -1 if unknown
+}sphw_rec;
+
+// a trace file mapped into memory
+typedef struct _sphw_map
+{
+	int fd;
+	const char *base;
+	size_t len;
+}sphw_map;
+
+// callback for each record, returns non-zero to stop scanning
+typedef int (*sphw_rec_fn)(const sphw_rec *rec, void *arg);
+
+int sphw_map_open(const char *path, sphw_map *map);
+void sphw_map_close(sphw_map *map);
+
+// split [base, base+len) into n chunks ending at line boundaries
+//	bounds must hold n+1 offsets, chunk i is [bounds[i], bounds[i+1])
+void sphw_split(const char *base, size_t len, int n, size_t *bounds);
+
+// parse one line [p, end) into rec, returns 0 if it is not a record
+int sphw_parse_line(const char *p, const char *end, sphw_rec *rec);
+
+// call fn for every record in [p, end), returns the number of records
+unsigned long long sphw_scan(const char *p, const char *end, sphw_rec_fn fn, void *arg);
+
+// call fn for every record read from fd (pipe, /proc file, ...), returns the number of records
+//	rec->fs_name is valid only inside fn
+unsigned long long sphw_scan_fd(int fd, sphw_rec_fn fn, void *arg);
+
+// name of a write class : "data", "node" ..., "-" if unknown
+const char *sphw_class_name(int wclass);
+
+#endif
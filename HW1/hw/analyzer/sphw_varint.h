@@ -0,0 +1,62 @@
+/*
+ * delta / zigzag / varint coding for sphw columns
+ *	consecutive records are close : sectors grow by small steps, times are monotonic,
+ *	so deltas are small and most of them fit in one or two bytes.
+ */
+
+#ifndef _SPHW_VARINT_H
+#define _SPHW_VARINT_H
+
+#include <stdint.h>
+
+#define VARINT_MAX 10		// bytes of the longest 64-bit varint
+
+// signed delta -> unsigned : 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...
+static inline uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// 7 bits per byte, msb set if more bytes follow
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+
+	return p;
+}
+
+// returns NULL if the varint runs past end
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+	uint64_t x = 0;
+	int shift = 0;
+
+	// fast path : one byte
+	if (p < end && *p < 0x80) {
+		*v = *p;
+		return p + 1;
+	}
+
+	while (p < end && shift < 64) {
+		uint8_t b = *p++;
+		x |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*v = x;
+			return p;
+		}
+		shift += 7;
+	}
+
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,815 @@
+/*
+ * trace analyzer for /proc/myproc/myproc dumps (raw/ext4_result.txt, raw/f2fs_result.txt)
+ *	the file is mmap-ed and cut into chunks at line boundaries,
+ *	each chunk is scanned by its own thread, partial results are merged at the end.
+ *
+ * usage : trace_analyzer [-t threads] [-g seq gap] [-b lba bucket] [-B burst gap] [-x sections] file...
+ *	file '-' : read stdin, single thread
+ *	file may also be a trace_pack stream, chunks are cut at frame boundaries
+ *	sections : f -> per file system summary
+ *	           s -> writes per second
+ *	           l -> LBA histogram
+ *	           r -> sequential run length distribution
+ *	           c -> records / bytes of each write class (data, node, meta, gc, journal)
+ *	           i -> inter-arrival times and bursts per device and file system (needs ns)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sphw_trace.h"
+#include "sphw_stream.h"
+
+#define FS_MAX 8			// maximum number of file systems in a trace
+#define RUN_BUCKETS 40		// log2 buckets of sequential run length
+#define GAP_BUCKETS 48		// log2 buckets of inter-arrival time (ns)
+#define ARR_MAX 32			// (device, file system) pairs in a trace
+#define MAP_EMPTY (~0ULL)
+
+// options
+static int n_threads;
+static unsigned long long seq_gap = 2048;		// max forward jump (sectors) of a sequential write
+static unsigned long long lba_bucket = 1 << 21;	// sectors per LBA histogram bucket : 1GB
+static unsigned long long burst_gap = 1000000;	// max gap (ns) between writes of one burst : 1ms
+static const char *sections = "fslrci";
+
+// hash map : key -> count
+typedef struct _count_map
+{
+	unsigned long long *keys;
+	unsigned long long *vals;
+	size_t cap;		// power of 2
+	size_t used;
+}count_map;
+
+// sequential runs of one file system
+//	only runs completely inside a chunk go to hist,
+//	the first and the last run of a chunk can continue in its neighbor.
+typedef struct _run_state
+{
+	unsigned long long k;		// number of runs
+	unsigned long long head;	// length of first run
+	unsigned long long tail;	// length of last run (== head if k == 1)
+	unsigned long long hist[RUN_BUCKETS];
+}run_state;
+
+// statistics of one file system
+typedef struct _fs_stat
+{
+	char name[FS_NAME_MAX];
+	unsigned long long records;
+	unsigned long long bytes;
+	long min_time, max_time;
+	unsigned long long min_blk, max_blk;
+	unsigned long long first_blk, last_blk;	// in file order
+	unsigned long long seq;					// sequential writes
+	run_state runs;
+	unsigned long long class_records[SPHW_CLASSES + 1];	// [0] : unknown class, [c + 1] : class c
+	unsigned long long class_bytes[SPHW_CLASSES + 1];
+}fs_stat;
+
+// arrivals of writes to one device from one file system
+//	bursts are runs of writes with gaps <= burst_gap, merged between chunks like sequential runs.
+//	records are in the order of the trace, a write submitted on another cpu may come
+//	a little earlier than the one before it : such gaps count as 0.
+typedef struct _arrival
+{
+	unsigned int dev;
+	char fs[FS_NAME_MAX];
+	unsigned long long events;
+	unsigned long long first_ns, last_ns;	// in file order
+	unsigned long long gap_hist[GAP_BUCKETS];	// [0] : 0, [b] : [2^(b-1), 2^b) ns
+	unsigned long long idle, idle_ns, max_idle;	// gaps longer than burst_gap
+	run_state bursts;
+}arrival;
+
+// one thread scanning one chunk
+typedef struct _worker
+{
+	pthread_t tid;
+	const char *begin, *end;
+	int fd;				// >= 0 : read the trace from fd instead of begin..end
+	int stream;			// begin..end are frames of a trace_pack stream
+	int nfs;
+	unsigned long long fs_dropped;	// records of file systems past FS_MAX
+	fs_stat fs[FS_MAX];
+	count_map per_sec;	// fs << 48 | time
+	count_map sec_bytes;	// fs << 48 | time
+	count_map lba;		// fs << 56 | bucket
+	int narr;
+	arrival arr[ARR_MAX];
+}worker;
+
+
+static void map_init(count_map *m)
+{
+	m->cap = 1024;
+	m->used = 0;
+	m->keys = malloc(m->cap * sizeof(*m->keys));
+	m->vals = malloc(m->cap * sizeof(*m->vals));
+	if (!m->keys || !m->vals) {
+		perror("trace_analyzer : malloc");
+		exit(1);
+	}
+	memset(m->keys, 0xff, m->cap * sizeof(*m->keys));
+}
+
+static void map_free(count_map *m)
+{
+	free(m->keys);
+	free(m->vals);
+}
+
+static inline size_t map_hash(unsigned long long key, size_t cap)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return key & (cap - 1);
+}
+
+static void map_add(count_map *m, unsigned long long key, unsigned long long val);
+
+static void map_grow(count_map *m)
+{
+	count_map old = *m;
+	size_t i;
+
+	m->cap *= 2;
+	m->used = 0;
+	m->keys = malloc(m->cap * sizeof(*m->keys));
+	m->vals = malloc(m->cap * sizeof(*m->vals));
+	if (!m->keys || !m->vals) {
+		perror("trace_analyzer : malloc");
+		exit(1);
+	}
+	memset(m->keys, 0xff, m->cap * sizeof(*m->keys));
+
+	for (i = 0; i < old.cap; i++)
+		if (old.keys[i] != MAP_EMPTY)
+			map_add(m, old.keys[i], old.vals[i]);
+
+	map_free(&old);
+}
+
+static void map_add(count_map *m, unsigned long long key, unsigned long long val)
+{
+	size_t i = map_hash(key, m->cap);
+
+	while (m->keys[i] != MAP_EMPTY) {
+		if (m->keys[i] == key) {
+			m->vals[i] += val;
+			return;
+		}
+		i = (i + 1) & (m->cap - 1);
+	}
+
+	m->keys[i] = key;
+	m->vals[i] = val;
+
+	// keep load factor under 1/2
+	if (++m->used * 2 > m->cap)
+		map_grow(m);
+}
+
+static inline int log2_bucket(unsigned long long v)
+{
+	int b = 63 - __builtin_clzll(v);
+	return b < RUN_BUCKETS ? b : RUN_BUCKETS - 1;
+}
+
+// find a file system by name, or add it
+static int fs_lookup(fs_stat *fs, int *nfs, const char *name, int len)
+{
+	int i;
+
+	for (i = 0; i < *nfs; i++)
+		if (!strncmp(fs[i].name, name, len) && fs[i].name[len] == '\0')
+			return i;
+
+	if (*nfs == FS_MAX)
+		return -1;
+
+	memset(&fs[i], 0, sizeof(fs[i]));
+	memcpy(fs[i].name, name, len);
+	fs[i].name[len] = '\0';
+	(*nfs)++;
+
+	return i;
+}
+
+// find a (device, file system) pair, or add it
+static int arr_lookup(arrival *arr, int *narr, unsigned int dev, const char *name, int len)
+{
+	int i;
+
+	for (i = 0; i < *narr; i++)
+		if (arr[i].dev == dev && !strncmp(arr[i].fs, name, len) && arr[i].fs[len] == '\0')
+			return i;
+
+	if (*narr == ARR_MAX)
+		return -1;
+
+	memset(&arr[i], 0, sizeof(arr[i]));
+	arr[i].dev = dev;
+	memcpy(arr[i].fs, name, len);
+	arr[i].fs[len] = '\0';
+	(*narr)++;
+
+	return i;
+}
+
+static inline int gap_bucket(unsigned long long gap)
+{
+	int b = gap ? 64 - __builtin_clzll(gap) : 0;
+	return b < GAP_BUCKETS ? b : GAP_BUCKETS - 1;
+}
+
+static inline int is_seq(unsigned long long prev, unsigned long long blk)
+{
+	return blk > prev && blk - prev <= seq_gap;
+}
+
+// extend runs of a chunk with the next element, join : it continues the last run
+static inline void add_to_runs(run_state *r, int join)
+{
+	if (join) {
+		if (r->k == 1)
+			r->head++;
+		r->tail++;
+	} else {
+		// the last run is closed : it's internal unless it's the first one
+		if (r->k > 1)
+			r->hist[log2_bucket(r->tail)]++;
+		r->k++;
+		r->tail = 1;
+	}
+}
+
+// append runs of chunk b to a, join : a's last run and b's first run are the same run
+static void merge_runs(run_state *a, const run_state *b, int join)
+{
+	int i;
+
+	for (i = 0; i < RUN_BUCKETS; i++)
+		a->hist[i] += b->hist[i];
+
+	if (join) {
+		if (a->k == 1 && b->k == 1) {
+			a->head += b->head;
+			a->tail = a->head;
+		} else if (a->k == 1) {
+			a->head += b->head;
+			a->tail = b->tail;
+		} else if (b->k == 1) {
+			a->tail += b->head;
+		} else {
+			a->hist[log2_bucket(a->tail + b->head)]++;
+			a->tail = b->tail;
+		}
+		a->k += b->k - 1;
+	} else {
+		if (a->k > 1)
+			a->hist[log2_bucket(a->tail)]++;
+		if (b->k > 1)
+			a->hist[log2_bucket(b->head)]++;
+		a->tail = b->tail;
+		a->k += b->k;
+	}
+}
+
+// a gap between two writes, returns 1 if they are in the same burst
+static int add_gap(arrival *a, unsigned long long from, unsigned long long to)
+{
+	unsigned long long gap = to > from ? to - from : 0;
+
+	a->gap_hist[gap_bucket(gap)]++;
+	if (gap <= burst_gap)
+		return 1;
+
+	a->idle++;
+	a->idle_ns += gap;
+	if (gap > a->max_idle)
+		a->max_idle = gap;
+
+	return 0;
+}
+
+static void arrive(worker *w, const sphw_rec *rec)
+{
+	arrival *a;
+	int idx;
+
+	idx = arr_lookup(w->arr, &w->narr, rec->dev, rec->fs_name, rec->fs_len);
+	if (idx < 0)
+		return;
+	a = &w->arr[idx];
+
+	if (a->events == 0) {
+		a->first_ns = rec->ns;
+		a->bursts.k = 1;
+		a->bursts.head = a->bursts.tail = 1;
+	} else {
+		add_to_runs(&a->bursts, add_gap(a, a->last_ns, rec->ns));
+	}
+	a->last_ns = rec->ns;
+	a->events++;
+}
+
+// append chunk b (later in the file) to a
+static void merge_arrival(arrival *a, const arrival *b)
+{
+	int i;
+
+	if (b->events == 0)
+		return;
+	if (a->events == 0) {
+		*a = *b;
+		return;
+	}
+
+	for (i = 0; i < GAP_BUCKETS; i++)
+		a->gap_hist[i] += b->gap_hist[i];
+	a->idle += b->idle;
+	a->idle_ns += b->idle_ns;
+	if (b->max_idle > a->max_idle)
+		a->max_idle = b->max_idle;
+
+	merge_runs(&a->bursts, &b->bursts, add_gap(a, a->last_ns, b->first_ns));
+	a->events += b->events;
+	a->last_ns = b->last_ns;
+}
+
+// per record : update statistics of the chunk
+static int account(const sphw_rec *rec, void *arg)
+{
+	worker *w = arg;
+	fs_stat *f;
+	int idx, seq;
+
+	idx = fs_lookup(w->fs, &w->nfs, rec->fs_name, rec->fs_len);
+	if (idx < 0) {
+		w->fs_dropped++;
+		return 0;
+	}
+	f = &w->fs[idx];
+
+	if (f->records == 0) {
+		f->min_time = f->max_time = rec->time;
+		f->min_blk = f->max_blk = rec->block_no;
+		f->first_blk = rec->block_no;
+		f->runs.k = 1;
+		f->runs.head = f->runs.tail = 1;
+	} else {
+		if (rec->time < f->min_time)
+			f->min_time = rec->time;
+		if (rec->time > f->max_time)
+			f->max_time = rec->time;
+		if (rec->block_no < f->min_blk)
+			f->min_blk = rec->block_no;
+		if (rec->block_no > f->max_blk)
+			f->max_blk = rec->block_no;
+
+		seq = is_seq(f->last_blk, rec->block_no);
+		f->seq += seq;
+		add_to_runs(&f->runs, seq);
+	}
+	f->last_blk = rec->block_no;
+	f->records++;
+	f->bytes += rec->size;
+	f->class_records[rec->wclass + 1]++;
+	f->class_bytes[rec->wclass + 1] += rec->size;
+
+	if (strchr(sections, 's')) {
+		unsigned long long key = ((unsigned long long)idx << 48) | (rec->time & 0xffffffffffffULL);
+		map_add(&w->per_sec, key, 1);
+		if (rec->size)
+			map_add(&w->sec_bytes, key, rec->size);
+	}
+	if (strchr(sections, 'l'))
+		map_add(&w->lba, ((unsigned long long)idx << 56) | (rec->block_no / lba_bucket), 1);
+	if (strchr(sections, 'i') && rec->ns)
+		arrive(w, rec);
+
+	return 0;
+}
+
+static void *scan_chunk(void *arg)
+{
+	worker *w = arg;
+
+	if (w->fd >= 0)
+		sphw_scan_fd(w->fd, account, w);
+	else if (!w->stream)
+		sphw_scan(w->begin, w->end, account, w);
+	else if (sphw_stream_scan(w->begin, w->end, account, w) < 0)
+		fprintf(stderr, "trace_analyzer : corrupted frame in the stream\n");
+
+	return NULL;
+}
+
+// append chunk b (later in the file) to a
+static void merge_fs(fs_stat *a, const fs_stat *b)
+{
+	int i, join;
+
+	if (b->records == 0)
+		return;
+	if (a->records == 0) {
+		*a = *b;
+		return;
+	}
+
+	a->records += b->records;
+	a->bytes += b->bytes;
+	a->seq += b->seq;
+	if (b->min_time < a->min_time)
+		a->min_time = b->min_time;
+	if (b->max_time > a->max_time)
+		a->max_time = b->max_time;
+	if (b->min_blk < a->min_blk)
+		a->min_blk = b->min_blk;
+	if (b->max_blk > a->max_blk)
+		a->max_blk = b->max_blk;
+
+	for (i = 0; i <= SPHW_CLASSES; i++) {
+		a->class_records[i] += b->class_records[i];
+		a->class_bytes[i] += b->class_bytes[i];
+	}
+
+	join = is_seq(a->last_blk, b->first_blk);
+	if (join)
+		a->seq++;
+	merge_runs(&a->runs, &b->runs, join);
+
+	a->last_blk = b->last_blk;
+}
+
+// close the first and the last run
+static void finish_runs(run_state *r, unsigned long long records)
+{
+	if (records == 0)
+		return;
+	r->hist[log2_bucket(r->head)]++;
+	if (r->k > 1)
+		r->hist[log2_bucket(r->tail)]++;
+}
+
+// merge map of one worker into the global map, renumbering file systems
+//	keys of file systems left out of the global table (remap < 0) are dropped
+static void merge_map(count_map *dst, const count_map *src, const int *remap, int shift)
+{
+	unsigned long long low = (1ULL << shift) - 1;
+	size_t i;
+
+	for (i = 0; i < src->cap; i++) {
+		unsigned long long key = src->keys[i];
+		if (key == MAP_EMPTY || remap[key >> shift] < 0)
+			continue;
+		map_add(dst, ((unsigned long long)remap[key >> shift] << shift) | (key & low), src->vals[i]);
+	}
+}
+
+typedef struct _kv
+{
+	unsigned long long key, val;
+}kv;
+
+static int kv_cmp(const void *a, const void *b)
+{
+	unsigned long long x = ((const kv *)a)->key, y = ((const kv *)b)->key;
+	return x < y ? -1 : x > y;
+}
+
+// entries of a map sorted by key
+static kv *map_sorted(const count_map *m, size_t *n)
+{
+	kv *arr = malloc((m->used + 1) * sizeof(*arr));
+	size_t i;
+
+	*n = 0;
+	for (i = 0; i < m->cap; i++)
+		if (m->keys[i] != MAP_EMPTY) {
+			arr[*n].key = m->keys[i];
+			arr[(*n)++].val = m->vals[i];
+		}
+	qsort(arr, *n, sizeof(*arr), kv_cmp);
+
+	return arr;
+}
+
+static void print_fs(const fs_stat *fs, int nfs)
+{
+	int i;
+
+	printf("== per file system ==\n");
+	printf("%-8s %12s %14s %12s %12s %14s %14s %7s %10s %9s\n",
+		"FS", "RECORDS", "BYTES", "FIRST", "LAST", "MIN_LBA", "MAX_LBA", "SEQ%", "RUNS", "AVG_RUN");
+	for (i = 0; i < nfs; i++) {
+		const fs_stat *f = &fs[i];
+		printf("%-8s %12llu %14llu %12ld %12ld %14llu %14llu %7.1f %10llu %9.1f\n",
+			f->name[0] ? f->name : "-", f->records, f->bytes, f->min_time, f->max_time,
+			f->min_blk, f->max_blk,
+			f->records > 1 ? 100.0 * f->seq / (f->records - 1) : 0.0,
+			f->runs.k, (double)f->records / f->runs.k);
+	}
+	printf("\n");
+}
+
+static unsigned long long map_get(const count_map *m, unsigned long long key)
+{
+	size_t i = map_hash(key, m->cap);
+
+	while (m->keys[i] != MAP_EMPTY) {
+		if (m->keys[i] == key)
+			return m->vals[i];
+		i = (i + 1) & (m->cap - 1);
+	}
+
+	return 0;
+}
+
+static void print_per_sec(const count_map *m, const count_map *bytes, const fs_stat *fs)
+{
+	size_t n, i;
+	kv *arr = map_sorted(m, &n);
+
+	printf("== writes per second ==\n");
+	printf("%-12s %-8s %10s %14s\n", "TIME", "FS", "WRITES", "BYTES");
+	for (i = 0; i < n; i++) {
+		const char *name = fs[arr[i].key >> 48].name;
+		printf("%-12llu %-8s %10llu %14llu\n", arr[i].key & 0xffffffffffffULL,
+			name[0] ? name : "-", arr[i].val, map_get(bytes, arr[i].key));
+	}
+	printf("\n");
+	free(arr);
+}
+
+static void print_lba(const count_map *m, const fs_stat *fs)
+{
+	size_t n, i;
+	kv *arr = map_sorted(m, &n);
+
+	printf("== LBA histogram (bucket = %llu sectors) ==\n", lba_bucket);
+	printf("%-8s %14s %14s %10s\n", "FS", "LBA_FROM", "LBA_TO", "WRITES");
+	for (i = 0; i < n; i++) {
+		const char *name = fs[arr[i].key >> 56].name;
+		unsigned long long b = arr[i].key & ((1ULL << 56) - 1);
+		printf("%-8s %14llu %14llu %10llu\n", name[0] ? name : "-",
+			b * lba_bucket, (b + 1) * lba_bucket - 1, arr[i].val);
+	}
+	printf("\n");
+	free(arr);
+}
+
+static void print_runs(const fs_stat *fs, int nfs)
+{
+	int i, b;
+
+	printf("== sequential run length (records, gap <= %llu sectors) ==\n", seq_gap);
+	printf("%-8s %12s %12s %10s\n", "FS", "LEN_FROM", "LEN_TO", "RUNS");
+	for (i = 0; i < nfs; i++)
+		for (b = 0; b < RUN_BUCKETS; b++) {
+			if (!fs[i].runs.hist[b])
+				continue;
+			printf("%-8s %12llu %12llu %10llu\n", fs[i].name[0] ? fs[i].name : "-",
+				1ULL << b, (2ULL << b) - 1, fs[i].runs.hist[b]);
+		}
+	printf("\n");
+}
+
+// file systems whose trace has no class field are left out
+static void print_classes(const fs_stat *fs, int nfs)
+{
+	int i, c, any = 0;
+
+	for (i = 0; i < nfs; i++)
+		any |= fs[i].class_records[0] != fs[i].records;
+	if (!any)
+		return;
+
+	printf("== write classes ==\n");
+	printf("%-8s %-8s %12s %14s %7s\n", "FS", "CLASS", "RECORDS", "BYTES", "BYTES%");
+	for (i = 0; i < nfs; i++) {
+		if (fs[i].class_records[0] == fs[i].records)
+			continue;
+		for (c = 0; c <= SPHW_CLASSES; c++) {
+			if (!fs[i].class_records[c])
+				continue;
+			printf("%-8s %-8s %12llu %14llu %7.1f\n", fs[i].name[0] ? fs[i].name : "-",
+				sphw_class_name(c - 1), fs[i].class_records[c], fs[i].class_bytes[c],
+				fs[i].bytes ? 100.0 * fs[i].class_bytes[c] / fs[i].bytes : 0.0);
+		}
+	}
+	printf("\n");
+}
+
+static void print_arrival(const arrival *arr, int narr)
+{
+	int i, b;
+
+	if (narr == 0)
+		return;
+
+	printf("== inter-arrival (burst : gaps <= %llu ns) ==\n", burst_gap);
+	printf("%-9s %-8s %12s %12s %10s %10s %10s %14s %14s\n", "DEV", "FS", "EVENTS", "MEAN_GAP_NS",
+		"BURSTS", "AVG_BURST", "IDLE", "MEAN_IDLE_NS", "MAX_IDLE_NS");
+	for (i = 0; i < narr; i++) {
+		const arrival *a = &arr[i];
+		char dev[16];
+
+		snprintf(dev, sizeof(dev), "%u:%u", a->dev >> 20, a->dev & 0xfffff);
+		printf("%-9s %-8s %12llu %12.0f %10llu %10.1f %10llu %14.0f %14llu\n",
+			dev, a->fs[0] ? a->fs : "-", a->events,
+			a->events > 1 && a->last_ns > a->first_ns ?
+				(double)(a->last_ns - a->first_ns) / (a->events - 1) : 0.0,
+			a->bursts.k, (double)a->events / a->bursts.k,
+			a->idle, a->idle ? (double)a->idle_ns / a->idle : 0.0, a->max_idle);
+	}
+	printf("\n");
+
+	printf("%-9s %-8s %14s %14s %10s\n", "DEV", "FS", "GAP_FROM_NS", "GAP_TO_NS", "GAPS");
+	for (i = 0; i < narr; i++) {
+		char dev[16];
+
+		snprintf(dev, sizeof(dev), "%u:%u", arr[i].dev >> 20, arr[i].dev & 0xfffff);
+		for (b = 0; b < GAP_BUCKETS; b++) {
+			if (!arr[i].gap_hist[b])
+				continue;
+			printf("%-9s %-8s %14llu %14llu %10llu\n", dev, arr[i].fs[0] ? arr[i].fs : "-",
+				b ? 1ULL << (b - 1) : 0, b ? (1ULL << b) - 1 : 0, arr[i].gap_hist[b]);
+		}
+	}
+	printf("\n");
+
+	printf("%-9s %-8s %12s %12s %10s\n", "DEV", "FS", "BURST_FROM", "BURST_TO", "BURSTS");
+	for (i = 0; i < narr; i++) {
+		char dev[16];
+
+		snprintf(dev, sizeof(dev), "%u:%u", arr[i].dev >> 20, arr[i].dev & 0xfffff);
+		for (b = 0; b < RUN_BUCKETS; b++) {
+			if (!arr[i].bursts.hist[b])
+				continue;
+			printf("%-9s %-8s %12llu %12llu %10llu\n", dev, arr[i].fs[0] ? arr[i].fs : "-",
+				1ULL << b, (2ULL << b) - 1, arr[i].bursts.hist[b]);
+		}
+	}
+	printf("\n");
+}
+
+static int analyze(const char *path)
+{
+	sphw_map map;
+	worker *w;
+	size_t *bounds;
+	fs_stat fs[FS_MAX];
+	count_map per_sec, sec_bytes, lba;
+	arrival arr[ARR_MAX];
+	int nfs = 0, narr = 0;
+	unsigned long long fs_dropped = 0;
+	int n = n_threads;
+	int from_stdin = !strcmp(path, "-");
+	int stream;
+	int i, j;
+
+	// stdin can't be mapped : one thread reads it as a stream
+	if (from_stdin) {
+		n = 1;
+		map.base = NULL;
+		map.len = 0;
+	} else if (sphw_map_open(path, &map) < 0) {
+		perror(path);
+		return -1;
+	}
+
+	w = calloc(n, sizeof(*w));
+	bounds = malloc((n + 1) * sizeof(*bounds));
+	stream = sphw_stream_is(map.base, map.len);
+	if (stream)
+		sphw_stream_split(map.base, map.len, n, bounds);
+	else
+		sphw_split(map.base, map.len, n, bounds);
+
+	for (i = 0; i < n; i++) {
+		w[i].begin = map.base + bounds[i];
+		w[i].end = map.base + bounds[i+1];
+		w[i].fd = from_stdin ? STDIN_FILENO : -1;
+		w[i].stream = stream;
+		map_init(&w[i].per_sec);
+		map_init(&w[i].sec_bytes);
+		map_init(&w[i].lba);
+		if (pthread_create(&w[i].tid, NULL, scan_chunk, &w[i])) {
+			perror("trace_analyzer : pthread_create");
+			exit(1);
+		}
+	}
+
+	// merge chunks in file order
+	map_init(&per_sec);
+	map_init(&sec_bytes);
+	map_init(&lba);
+	for (i = 0; i < n; i++) {
+		int remap[FS_MAX];
+
+		pthread_join(w[i].tid, NULL);
+
+		for (j = 0; j < w[i].nfs; j++) {
+			remap[j] = fs_lookup(fs, &nfs, w[i].fs[j].name, strlen(w[i].fs[j].name));
+			if (remap[j] >= 0)
+				merge_fs(&fs[remap[j]], &w[i].fs[j]);
+			else
+				fs_dropped += w[i].fs[j].records;
+		}
+		fs_dropped += w[i].fs_dropped;
+		for (j = 0; j < w[i].narr; j++) {
+			const arrival *a = &w[i].arr[j];
+			int k = arr_lookup(arr, &narr, a->dev, a->fs, strlen(a->fs));
+			if (k >= 0)
+				merge_arrival(&arr[k], a);
+		}
+		merge_map(&per_sec, &w[i].per_sec, remap, 48);
+		merge_map(&sec_bytes, &w[i].sec_bytes, remap, 48);
+		merge_map(&lba, &w[i].lba, remap, 56);
+		map_free(&w[i].per_sec);
+		map_free(&w[i].sec_bytes);
+		map_free(&w[i].lba);
+	}
+	if (fs_dropped)
+		fprintf(stderr, "trace_analyzer : more than %d file systems, %llu records of the others are left out\n",
+			FS_MAX, fs_dropped);
+	for (i = 0; i < nfs; i++)
+		finish_runs(&fs[i].runs, fs[i].records);
+	for (i = 0; i < narr; i++)
+		finish_runs(&arr[i].bursts, arr[i].events);
+
+	printf("# %s\n\n", path);
+	if (strchr(sections, 'f'))
+		print_fs(fs, nfs);
+	if (strchr(sections, 's'))
+		print_per_sec(&per_sec, &sec_bytes, fs);
+	if (strchr(sections, 'l'))
+		print_lba(&lba, fs);
+	if (strchr(sections, 'r'))
+		print_runs(fs, nfs);
+	if (strchr(sections, 'c'))
+		print_classes(fs, nfs);
+	if (strchr(sections, 'i'))
+		print_arrival(arr, narr);
+
+	map_free(&per_sec);
+	map_free(&sec_bytes);
+	map_free(&lba);
+	free(bounds);
+	free(w);
+	if (!from_stdin)
+		sphw_map_close(&map);
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : trace_analyzer [-t threads] [-g seq gap] [-b lba bucket] [-B burst gap]"
+		" [-x fslrci] file...\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, ret = 0;
+
+	n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((opt = getopt(argc, argv, "t:g:b:B:x:")) != -1) {
+		switch (opt) {
+		case 't':
+			n_threads = atoi(optarg);
+			break;
+		case 'g':
+			seq_gap = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			lba_bucket = strtoull(optarg, NULL, 0);
+			break;
+		case 'B':
+			burst_gap = strtoull(optarg, NULL, 0);
+			break;
+		case 'x':
+			sections = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc || n_threads < 1 || lba_bucket == 0)
+		usage();
+
+	for (; optind < argc; optind++)
+		if (analyze(argv[optind]) < 0)
+			ret = 1;
+
+	return ret;
+}
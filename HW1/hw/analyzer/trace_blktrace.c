@@ -0,0 +1,230 @@
+/*
+ * sphw trace -> blktrace binary format
+ *	every record becomes a Q (queued) event of struct blk_io_trace,
+ *	written to <name>.blktrace.<cpu> like blktrace does, so blkparse, btt and iowatcher
+ *	read it with "-i <name>".
+ *	time is ns since the first record, sequence numbers are counted per cpu.
+ *
+ *	input : text dump (/proc/myproc/myproc, relay_reader -d, '-' for stdin) or a trace_store file.
+ *	records without dev (older dumps, stores) get the device of -d.
+ *
+ * usage : trace_blktrace [-o name] [-d major,minor] [-f fs] trace...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <linux/blktrace_api.h>
+
+#include "sphw_trace.h"
+#include "sphw_store.h"
+
+typedef struct _events
+{
+	struct blk_io_trace *t;
+	size_t n, cap;
+}events;
+
+// options
+static unsigned int default_dev;
+static const char *fs_filter;
+
+// bio flags -> blktrace categories of a Q event
+static uint32_t rw_to_action(unsigned long rw)
+{
+	uint32_t tc = (rw & REQ_WRITE) ? BLK_TC_WRITE : BLK_TC_READ;
+
+	if (rw & REQ_SYNC)
+		tc |= BLK_TC_SYNC;
+	if (rw & REQ_META)
+		tc |= BLK_TC_META;
+	if (rw & REQ_DISCARD)
+		tc |= BLK_TC_DISCARD;
+	if (rw & REQ_FUA)
+		tc |= BLK_TC_FUA;
+	if (rw & REQ_FLUSH)
+		tc |= BLK_TC_FLUSH;
+
+	return BLK_TA_QUEUE | BLK_TC_ACT(tc);
+}
+
+static int add_rec(const sphw_rec *rec, void *arg)
+{
+	events *ev = arg;
+	struct blk_io_trace *t;
+
+	if (fs_filter && (strncmp(fs_filter, rec->fs_name, rec->fs_len) || fs_filter[rec->fs_len]))
+		return 0;
+
+	if (ev->n == ev->cap) {
+		ev->cap = ev->cap ? ev->cap * 2 : 4096;
+		ev->t = realloc(ev->t, ev->cap * sizeof(*ev->t));
+		if (!ev->t) {
+			perror("trace_blktrace : realloc");
+			exit(1);
+		}
+	}
+
+	t = &ev->t[ev->n++];
+	memset(t, 0, sizeof(*t));
+	t->magic = BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION;
+	t->time = rec->ns ? rec->ns : (uint64_t)rec->time * 1000000000ULL;
+	t->sector = rec->block_no;
+	t->bytes = rec->size;
+	t->action = rw_to_action(rec->rw);
+	t->pid = rec->pid;
+	t->device = rec->dev ? rec->dev : default_dev;
+	t->cpu = rec->cpu;
+
+	return 0;
+}
+
+static int by_time(const void *a, const void *b)
+{
+	const struct blk_io_trace *x = a, *y = b;
+
+	return x->time < y->time ? -1 : x->time > y->time;
+}
+
+static int read_trace(const char *path, events *ev)
+{
+	store_reader r;
+	sphw_map map;
+
+	if (!strcmp(path, "-")) {
+		sphw_scan_fd(STDIN_FILENO, add_rec, ev);
+		return 0;
+	}
+
+	if (sphw_store_open(&r, path) == 0) {
+		store_query q;
+		int ret;
+
+		sphw_store_query_init(&q);
+		ret = sphw_store_query(&r, &q, add_rec, ev);
+		sphw_store_close(&r);
+		if (ret < 0)
+			fprintf(stderr, "trace_blktrace : %s is corrupted\n", path);
+		return ret < 0 ? -1 : 0;
+	}
+
+	if (sphw_map_open(path, &map) < 0) {
+		perror(path);
+		return -1;
+	}
+	sphw_scan(map.base, map.base + map.len, add_rec, ev);
+	sphw_map_close(&map);
+
+	return 0;
+}
+
+// sorted events -> one file per cpu
+static int write_blktrace(events *ev, const char *name)
+{
+	FILE **out = NULL;
+	uint32_t *seq = NULL;
+	uint64_t base = ev->n ? ev->t[0].time : 0;
+	uint32_t n_cpus = 0, c;
+	char path[256];
+	size_t i;
+
+	for (i = 0; i < ev->n; i++)
+		if (ev->t[i].cpu + 1 > n_cpus)
+			n_cpus = ev->t[i].cpu + 1;
+
+	out = calloc(n_cpus, sizeof(*out));
+	seq = calloc(n_cpus, sizeof(*seq));
+	if (n_cpus && (!out || !seq)) {
+		perror("trace_blktrace : calloc");
+		free(out);
+		free(seq);
+		return -1;
+	}
+
+	for (i = 0; i < ev->n; i++) {
+		struct blk_io_trace *t = &ev->t[i];
+
+		c = t->cpu;
+		if (!out[c]) {
+			snprintf(path, sizeof(path), "%s.blktrace.%u", name, c);
+			out[c] = fopen(path, "wb");
+			if (!out[c]) {
+				perror(path);
+				return -1;
+			}
+		}
+
+		t->time -= base;
+		t->sequence = ++seq[c];
+		if (fwrite(t, sizeof(*t), 1, out[c]) != 1) {
+			perror("trace_blktrace : write");
+			return -1;
+		}
+	}
+
+	for (c = 0; c < n_cpus; c++)
+		if (out[c])
+			fclose(out[c]);
+
+	fprintf(stderr, "trace_blktrace : %zu events, %s.blktrace.[0-%u]\n", ev->n, name, n_cpus - 1);
+
+	free(seq);
+	free(out);
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : trace_blktrace [-o name] [-d major,minor] [-f fs] trace...\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = "sphw";
+	events ev = { NULL, 0, 0 };
+	unsigned int major, minor;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "o:d:f:")) != -1) {
+		switch (opt) {
+		case 'o':
+			name = optarg;
+			break;
+		case 'd':
+			if (sscanf(optarg, "%u,%u", &major, &minor) != 2)
+				usage();
+			default_dev = major << 20 | minor;
+			break;
+		case 'f':
+			fs_filter = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc)
+		usage();
+
+	for (i = optind; i < argc; i++)
+		if (read_trace(argv[i], &ev) < 0)
+			return 1;
+
+	if (ev.n == 0) {
+		fprintf(stderr, "trace_blktrace : no records\n");
+		return 1;
+	}
+
+	// blkparse merges the cpus by time, each file must be in time order
+	qsort(ev.t, ev.n, sizeof(*ev.t), by_time);
+
+	if (write_blktrace(&ev, name) < 0)
+		return 1;
+
+	free(ev.t);
+
+	return 0;
+}
@@ -0,0 +1,504 @@
+/*
+ * block -> file reverse mapping of a sphw trace
+ *	1. walks a mounted file system, one directory at a time per thread,
+ *	   and collects the extents of every regular file with FIEMAP
+ *	2. sorts the extents by physical sector
+ *	3. finds the file of each record with a binary search
+ *	   (chunks of the trace in parallel, like trace_analyzer)
+ *
+ *	block_no of a record is the sector submitted to the partition the file system is on,
+ *	fe_physical of FIEMAP is relative to the same partition.
+ *	the map is a snapshot : blocks freed or moved since the trace was taken match wrong files or none.
+ *
+ * usage : trace_files -r mountpoint [-j threads] [-f fs] [-n top] [-a] trace
+ *	-a : print every record with " || file : path" instead of the per file report
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "sphw_trace.h"
+
+#define FIEMAP_BATCH 256		// extents per FIEMAP call
+#define NO_FILE "-"				// records outside every extent : metadata, free space
+
+// physical extent of a file, in sectors
+typedef struct _extent
+{
+	uint64_t start, end;		// [start, end)
+	uint32_t file;
+}extent;
+
+typedef struct _extent_list
+{
+	extent *e;
+	size_t n, cap;
+}extent_list;
+
+// directories left to walk, shared by the walkers
+typedef struct _dir_queue
+{
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	char **dirs;
+	size_t n, cap;
+	int busy;				// walkers reading a directory, they may push more
+	dev_t dev;				// stay on this file system
+}dir_queue;
+
+typedef struct _walker
+{
+	pthread_t tid;
+	dir_queue *q;
+	extent_list ext;
+	char **files;			// paths, index = extent.file
+	size_t nfiles, cap;
+	unsigned long long bad;	// files FIEMAP failed on
+}walker;
+
+// a thread joining one chunk of the trace
+typedef struct _joiner
+{
+	pthread_t tid;
+	const char *begin, *end;
+	char *out;				// -a : annotated chunk
+	size_t out_len;
+	FILE *fp;
+}joiner;
+
+// writes to one file
+typedef struct _file_count
+{
+	uint32_t file;
+	unsigned long long writes, bytes;
+}file_count;
+
+// options
+static int n_threads;
+static const char *fs_filter;
+static int annotate;
+
+// merged map
+static extent *map;
+static size_t map_n;
+static char **paths;
+static size_t nfiles;
+
+// per file, [nfiles] : no file
+//	one array shared by the joiners, added to atomically : memory does not grow with -j
+static file_count *counts;
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		perror("trace_files : realloc");
+		exit(1);
+	}
+	return p;
+}
+
+static void queue_push(dir_queue *q, char *dir)
+{
+	pthread_mutex_lock(&q->lock);
+	if (q->n == q->cap) {
+		q->cap = q->cap ? q->cap * 2 : 64;
+		q->dirs = xrealloc(q->dirs, q->cap * sizeof(*q->dirs));
+	}
+	q->dirs[q->n++] = dir;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+// next directory, NULL when the queue is empty and nobody can add to it
+static char *queue_pop(dir_queue *q)
+{
+	char *dir = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	q->busy--;
+	while (q->n == 0 && q->busy > 0)
+		pthread_cond_wait(&q->cond, &q->lock);
+	if (q->n > 0) {
+		dir = q->dirs[--q->n];
+		q->busy++;
+	} else {
+		pthread_cond_broadcast(&q->cond);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return dir;
+}
+
+static void add_extent(walker *w, uint64_t start, uint64_t len, uint32_t file)
+{
+	extent_list *l = &w->ext;
+
+	if (l->n == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 1024;
+		l->e = xrealloc(l->e, l->cap * sizeof(*l->e));
+	}
+	l->e[l->n].start = start;
+	l->e[l->n].end = start + len;
+	l->e[l->n].file = file;
+	l->n++;
+}
+
+// extents of one file, file is its index in w->files
+static int map_file(walker *w, int fd, uint32_t file)
+{
+	char buf[sizeof(struct fiemap) + FIEMAP_BATCH * sizeof(struct fiemap_extent)];
+	struct fiemap *fm = (struct fiemap *)buf;
+	uint64_t pos = 0;
+	unsigned int i;
+
+	for (;;) {
+		memset(fm, 0, sizeof(*fm));
+		fm->fm_start = pos;
+		fm->fm_length = FIEMAP_MAX_OFFSET - pos;
+		fm->fm_extent_count = FIEMAP_BATCH;
+		if (ioctl(fd, FS_IOC_FIEMAP, fm) < 0)
+			return -1;
+		if (fm->fm_mapped_extents == 0)
+			return 0;
+
+		for (i = 0; i < fm->fm_mapped_extents; i++) {
+			struct fiemap_extent *fe = &fm->fm_extents[i];
+
+			// not on disk yet, or not at a usable address
+			if (!(fe->fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+			                      FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_NOT_ALIGNED)))
+				add_extent(w, fe->fe_physical >> 9, (fe->fe_length + 511) >> 9, file);
+
+			if (fe->fe_flags & FIEMAP_EXTENT_LAST)
+				return 0;
+			pos = fe->fe_logical + fe->fe_length;
+		}
+	}
+}
+
+static void walk_dir(walker *w, char *dir)
+{
+	DIR *d = opendir(dir);
+	struct dirent *de;
+	size_t dlen = strlen(dir);
+
+	if (!d) {
+		free(dir);
+		return;
+	}
+
+	while ((de = readdir(d)) != NULL) {
+		struct stat st;
+		char *path;
+		int fd;
+
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		if (de->d_type != DT_DIR && de->d_type != DT_REG && de->d_type != DT_UNKNOWN)
+			continue;
+		if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 || st.st_dev != w->q->dev)
+			continue;
+
+		path = malloc(dlen + strlen(de->d_name) + 2);
+		sprintf(path, "%s%s%s", dir, dir[dlen-1] == '/' ? "" : "/", de->d_name);
+
+		if (S_ISDIR(st.st_mode)) {
+			queue_push(w->q, path);
+			continue;
+		}
+		if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+			free(path);
+			continue;
+		}
+
+		fd = openat(dirfd(d), de->d_name, O_RDONLY | O_NOFOLLOW);
+		if (fd < 0) {
+			w->bad++;
+			free(path);
+			continue;
+		}
+		if (w->nfiles == w->cap) {
+			w->cap = w->cap ? w->cap * 2 : 1024;
+			w->files = xrealloc(w->files, w->cap * sizeof(*w->files));
+		}
+		if (map_file(w, fd, w->nfiles) < 0)
+			w->bad++;
+		w->files[w->nfiles++] = path;
+		close(fd);
+	}
+
+	closedir(d);
+	free(dir);
+}
+
+static void *walk(void *arg)
+{
+	walker *w = arg;
+	char *dir;
+
+	while ((dir = queue_pop(w->q)) != NULL)
+		walk_dir(w, dir);
+
+	return NULL;
+}
+
+static int by_start(const void *a, const void *b)
+{
+	const extent *x = a, *y = b;
+
+	return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static int build_map(const char *root)
+{
+	dir_queue q;
+	walker *w = calloc(n_threads, sizeof(*w));
+	unsigned long long bad = 0;
+	struct stat st;
+	size_t i, j;
+
+	if (stat(root, &st) < 0 || !S_ISDIR(st.st_mode)) {
+		fprintf(stderr, "trace_files : %s is not a directory\n", root);
+		return -1;
+	}
+
+	memset(&q, 0, sizeof(q));
+	pthread_mutex_init(&q.lock, NULL);
+	pthread_cond_init(&q.cond, NULL);
+	q.dev = st.st_dev;
+	q.busy = n_threads;		// each walker starts with a pop
+	queue_push(&q, strdup(root));
+
+	for (i = 0; i < (size_t)n_threads; i++) {
+		w[i].q = &q;
+		if (pthread_create(&w[i].tid, NULL, walk, &w[i])) {
+			perror("trace_files : pthread_create");
+			exit(1);
+		}
+	}
+
+	// renumber files : walker i's files follow walker i-1's
+	for (i = 0; i < (size_t)n_threads; i++) {
+		pthread_join(w[i].tid, NULL);
+
+		map = xrealloc(map, (map_n + w[i].ext.n) * sizeof(*map));
+		for (j = 0; j < w[i].ext.n; j++) {
+			map[map_n + j] = w[i].ext.e[j];
+			map[map_n + j].file += nfiles;
+		}
+		map_n += w[i].ext.n;
+
+		paths = xrealloc(paths, (nfiles + w[i].nfiles + 1) * sizeof(*paths));
+		memcpy(paths + nfiles, w[i].files, w[i].nfiles * sizeof(*paths));
+		nfiles += w[i].nfiles;
+		bad += w[i].bad;
+
+		free(w[i].ext.e);
+		free(w[i].files);
+	}
+	paths[nfiles] = NO_FILE;
+
+	qsort(map, map_n, sizeof(*map), by_start);
+
+	fprintf(stderr, "trace_files : %zu files, %zu extents", nfiles, map_n);
+	if (bad)
+		fprintf(stderr, ", FIEMAP failed on %llu files", bad);
+	fprintf(stderr, "\n");
+
+	free(q.dirs);
+	free(w);
+
+	return 0;
+}
+
+// file of a sector, nfiles if none
+static uint32_t lookup(uint64_t sector)
+{
+	size_t lo = 0, hi = map_n;
+
+	// last extent starting at or before sector
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (map[mid].start <= sector)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo > 0 && sector < map[lo-1].end)
+		return map[lo-1].file;
+
+	return nfiles;
+}
+
+static int join_rec(const sphw_rec *rec, void *arg)
+{
+	joiner *j = arg;
+	uint32_t file;
+
+	if (fs_filter && (strncmp(fs_filter, rec->fs_name, rec->fs_len) || fs_filter[rec->fs_len]))
+		return 0;
+
+	file = lookup(rec->block_no);
+
+	if (annotate) {
+		fprintf(j->fp, "time : %ld || FS_name : %.*s || block_no : %llu || size : %u || rw : 0x%lx"
+			" || ns : %llu || dev : %u,%u || pid : %d || cpu : %d || class : %s || file : %s\n",
+			rec->time, rec->fs_len, rec->fs_name, rec->block_no, rec->size, rec->rw, rec->ns,
+			rec->dev >> 20, rec->dev & 0xfffff, rec->pid, rec->cpu, sphw_class_name(rec->wclass),
+			paths[file]);
+	} else {
+		__atomic_fetch_add(&counts[file].writes, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&counts[file].bytes, rec->size, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+
+static void *join_chunk(void *arg)
+{
+	joiner *j = arg;
+
+	if (annotate)
+		j->fp = open_memstream(&j->out, &j->out_len);
+	sphw_scan(j->begin, j->end, join_rec, j);
+	if (annotate)
+		fclose(j->fp);
+
+	return NULL;
+}
+
+static int by_bytes(const void *a, const void *b)
+{
+	const file_count *x = a, *y = b;
+
+	if (x->bytes != y->bytes)
+		return x->bytes < y->bytes ? 1 : -1;
+	return x->writes < y->writes ? 1 : x->writes > y->writes ? -1 : 0;
+}
+
+// sorts counts, the joiners must be done
+static void report(int top)
+{
+	file_count *fc = counts;
+	unsigned long long total = 0;
+	size_t f, used = 0;
+
+	for (f = 0; f <= nfiles; f++) {
+		fc[f].file = f;
+		total += fc[f].bytes;
+		if (fc[f].writes)
+			used++;
+	}
+	qsort(fc, nfiles + 1, sizeof(*fc), by_bytes);
+
+	printf("== files (%zu written) ==\n", used);
+	printf("%12s %14s %7s  %s\n", "WRITES", "BYTES", "BYTES%", "FILE");
+	for (f = 0; f <= nfiles && (top == 0 || f < (size_t)top); f++) {
+		if (!fc[f].writes)
+			break;
+		printf("%12llu %14llu %7.1f  %s\n", fc[f].writes, fc[f].bytes,
+			total ? 100.0 * fc[f].bytes / total : 0.0, paths[fc[f].file]);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : trace_files -r mountpoint [-j threads] [-f fs] [-n top] [-a] trace\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *root = NULL;
+	int top = 20;
+	sphw_map tmap;
+	joiner *j;
+	size_t *bounds;
+	int opt, i;
+
+	n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((opt = getopt(argc, argv, "r:j:f:n:a")) != -1) {
+		switch (opt) {
+		case 'r':
+			root = optarg;
+			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			break;
+		case 'f':
+			fs_filter = optarg;
+			break;
+		case 'n':
+			top = atoi(optarg);
+			break;
+		case 'a':
+			annotate = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!root || optind != argc - 1 || n_threads < 1)
+		usage();
+
+	if (sphw_map_open(argv[optind], &tmap) < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (build_map(root) < 0)
+		return 1;
+
+	if (!annotate) {
+		counts = calloc(nfiles + 1, sizeof(*counts));
+		if (!counts) {
+			perror("trace_files : calloc");
+			return 1;
+		}
+	}
+
+	j = calloc(n_threads, sizeof(*j));
+	bounds = malloc((n_threads + 1) * sizeof(*bounds));
+	sphw_split(tmap.base, tmap.len, n_threads, bounds);
+
+	for (i = 0; i < n_threads; i++) {
+		j[i].begin = tmap.base + bounds[i];
+		j[i].end = tmap.base + bounds[i+1];
+		if (pthread_create(&j[i].tid, NULL, join_chunk, &j[i])) {
+			perror("trace_files : pthread_create");
+			return 1;
+		}
+	}
+
+	// chunks in file order
+	for (i = 0; i < n_threads; i++) {
+		pthread_join(j[i].tid, NULL);
+		if (annotate) {
+			fwrite(j[i].out, 1, j[i].out_len, stdout);
+			free(j[i].out);
+		}
+	}
+
+	if (!annotate)
+		report(top);
+
+	free(counts);
+	free(j);
+	free(bounds);
+	sphw_map_close(&tmap);
+
+	return 0;
+}
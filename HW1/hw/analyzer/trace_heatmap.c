@@ -0,0 +1,449 @@
+/*
+ * LBA-over-time heatmap of a sphw trace
+ *	input : text dump (raw/ext4_result.txt, /proc/myproc/myproc, '-' for stdin) or a trace_store file
+ *	output : binary PPM, x -> time, y -> LBA (0 at the bottom), color -> writes per bin (log scale)
+ *
+ *	one pass, memory is one width x height grid per thread :
+ *	an axis covers [origin, origin + n * scale), when a value falls outside,
+ *	scale is doubled and neighbor bins are merged until it fits.
+ *	bins are aligned to multiples of scale, so an axis only depends on the smallest
+ *	and largest value and not on their order : the picture is the same for any -j.
+ *
+ * usage : trace_heatmap [-W width] [-H height] [-t from:to] [-l from:to] [-f fs] [-j threads]
+ *                       [-o out.ppm] trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "sphw_trace.h"
+#include "sphw_store.h"
+
+// one axis of the grid
+typedef struct _axis
+{
+	int n;				// bins
+	int fixed;			// range given by user, values outside are dropped
+	int empty;			// no value yet
+	int64_t origin;		// value of bin 0, a multiple of scale unless fixed
+	uint64_t scale;		// values per bin, power of 2 unless fixed
+	int last;			// highest bin holding a value, unless fixed
+}axis;
+
+typedef struct _grid
+{
+	axis x, y;			// time, LBA
+	uint64_t *cnt;		// cnt[row * x.n + col], row 0 is the lowest LBA
+}grid;
+
+// a thread rendering one chunk of a text trace
+typedef struct _worker
+{
+	pthread_t tid;
+	const char *begin, *end;
+	grid g;
+}worker;
+
+// options
+static int width = 1024, height = 768;
+static int64_t t_from = INT64_MIN, t_to = INT64_MAX;	// seconds
+static int64_t l_from = INT64_MIN, l_to = INT64_MAX;	// sectors
+static const char *fs_filter;
+
+static void axis_init(axis *a, int n, int64_t from, int64_t to)
+{
+	a->n = n;
+	a->empty = 1;
+	a->fixed = from != INT64_MIN && to != INT64_MAX;
+	a->origin = 0;
+	a->scale = 1;
+	a->last = 0;
+
+	if (a->fixed) {
+		a->empty = 0;
+		a->origin = from;
+		a->scale = ((uint64_t)(to - from) + n) / n;
+	}
+}
+
+// LBA axis starts at sector 0, so the picture shows where on the device the writes go
+static void axis_init_lba(axis *a, int n, int64_t from, int64_t to)
+{
+	axis_init(a, n, from, to);
+	a->empty = 0;
+}
+
+static void grid_init(grid *g, int64_t t0, int64_t t1, int64_t l0, int64_t l1)
+{
+	axis_init(&g->x, width, t0, t1);
+	axis_init_lba(&g->y, height, l0, l1);
+	g->cnt = calloc((size_t)width * height, sizeof(*g->cnt));
+	if (!g->cnt) {
+		perror("trace_heatmap : calloc");
+		exit(1);
+	}
+}
+
+// floor(v / d) for d > 0, also for negative v
+static inline int64_t floor_div(int64_t v, uint64_t d)
+{
+	return v >= 0 ? (int64_t)((uint64_t)v / d) : -(int64_t)(((uint64_t)-(v + 1)) / d) - 1;
+}
+
+// double the scale of x (dim 0) or y (dim 1), merging bin pairs
+//	bins stay aligned : absolute bin k goes to k / 2, so an odd first bin shares its new bin
+static void grid_grow(grid *g, int dim)
+{
+	axis *a = dim ? &g->y : &g->x;
+	int64_t base = a->origin / (int64_t)a->scale;
+	int odd = base & 1;
+	int w = g->x.n, h = g->y.n;
+	int c, r;
+	uint64_t *tmp;
+
+	if (dim == 0) {
+		// one row of scratch, the width comes from -W and may not fit the stack
+		tmp = malloc((size_t)w * sizeof(*tmp));
+		if (!tmp) {
+			perror("trace_heatmap : malloc");
+			exit(1);
+		}
+		for (r = 0; r < h; r++) {
+			uint64_t *row = g->cnt + (size_t)r * w;
+
+			memset(tmp, 0, (size_t)w * sizeof(*tmp));
+			for (c = 0; c <= a->last; c++)
+				tmp[(c + odd) / 2] += row[c];
+			memcpy(row, tmp, (size_t)w * sizeof(*tmp));
+		}
+		free(tmp);
+	} else {
+		tmp = calloc((size_t)w * h, sizeof(*tmp));
+		if (!tmp) {
+			perror("trace_heatmap : calloc");
+			exit(1);
+		}
+		for (r = 0; r <= a->last; r++) {
+			uint64_t *dst = tmp + (size_t)((r + odd) / 2) * w;
+			for (c = 0; c < w; c++)
+				dst[c] += g->cnt[(size_t)r * w + c];
+		}
+		free(g->cnt);
+		g->cnt = tmp;
+	}
+
+	a->scale *= 2;
+	a->origin = floor_div(base, 2) * (int64_t)a->scale;
+	a->last = (a->last + odd) / 2;
+}
+
+// move the bins of x (dim 0) or y (dim 1) up by d, the first d bins become empty
+static void grid_shift(grid *g, int dim, int d)
+{
+	axis *a = dim ? &g->y : &g->x;
+	int w = g->x.n;
+	int r;
+
+	if (dim == 0) {
+		for (r = 0; r < g->y.n; r++) {
+			uint64_t *row = g->cnt + (size_t)r * w;
+
+			memmove(row + d, row, (size_t)(a->last + 1) * sizeof(*row));
+			memset(row, 0, (size_t)d * sizeof(*row));
+		}
+	} else {
+		memmove(g->cnt + (size_t)d * w, g->cnt, (size_t)(a->last + 1) * w * sizeof(*g->cnt));
+		memset(g->cnt, 0, (size_t)d * w * sizeof(*g->cnt));
+	}
+
+	a->origin -= (int64_t)(d * a->scale);
+	a->last += d;
+}
+
+// make axis dim cover v, returns the bin of v or -1 if it's dropped
+//	an adaptive axis ends at the smallest scale that fits all values, starting at the bin of the smallest
+static inline int grid_fit(grid *g, int dim, int64_t v)
+{
+	axis *a = dim ? &g->y : &g->x;
+
+	if (a->empty) {
+		a->empty = 0;
+		a->origin = v;
+		a->scale = 1;
+		a->last = 0;
+		return 0;
+	}
+
+	if (a->fixed) {
+		if (v < a->origin || (uint64_t)(v - a->origin) / a->scale >= (uint64_t)a->n)
+			return -1;
+		return (uint64_t)(v - a->origin) / a->scale;
+	}
+
+	for (;;) {
+		int64_t base = a->origin / (int64_t)a->scale;
+		int64_t b = floor_div(v, a->scale) - base;
+
+		if (b < 0 && a->last - b < a->n) {
+			grid_shift(g, dim, -b);
+			return 0;
+		}
+		if (b >= 0 && b < a->n) {
+			if (b > a->last)
+				a->last = b;
+			return b;
+		}
+		grid_grow(g, dim);
+	}
+}
+
+// time of a record : monotonic ns if the trace has it, otherwise the wall second
+static inline int64_t rec_time(const sphw_rec *rec)
+{
+	return rec->ns ? (int64_t)rec->ns : (int64_t)rec->time * 1000000000LL;
+}
+
+static int plot(const sphw_rec *rec, void *arg)
+{
+	grid *g = arg;
+	int c, r;
+
+	if (rec->time < t_from || rec->time > t_to)
+		return 0;
+	if ((int64_t)rec->block_no < l_from || (int64_t)rec->block_no > l_to)
+		return 0;
+	if (fs_filter && (strncmp(fs_filter, rec->fs_name, rec->fs_len) || fs_filter[rec->fs_len]))
+		return 0;
+
+	c = grid_fit(g, 0, rec_time(rec));
+	r = grid_fit(g, 1, rec->block_no);
+	if (c >= 0 && r >= 0)
+		g->cnt[(size_t)r * g->x.n + c]++;
+
+	return 0;
+}
+
+static void *render_chunk(void *arg)
+{
+	worker *w = arg;
+
+	sphw_scan(w->begin, w->end, plot, &w->g);
+
+	return NULL;
+}
+
+// make axis dim of g cover the values of axis src, at src's scale or more
+static void grid_cover(grid *g, int dim, const axis *src)
+{
+	axis *a = dim ? &g->y : &g->x;
+
+	if (a->fixed)
+		return;
+
+	grid_fit(g, dim, src->origin);
+	grid_fit(g, dim, src->origin + (int64_t)(src->last * src->scale));
+	while (a->scale < src->scale)
+		grid_grow(g, dim);
+}
+
+// add src into dst
+//	both grids are aligned and dst has the larger scales, so each src bin is inside one dst bin
+static void grid_merge(grid *dst, const grid *src)
+{
+	int c, r;
+
+	if (src->x.empty || src->y.empty)
+		return;
+
+	// cover the whole src range first, so that dst does not fold in the middle
+	grid_cover(dst, 0, &src->x);
+	grid_cover(dst, 1, &src->y);
+
+	for (r = 0; r < src->y.n; r++)
+		for (c = 0; c < src->x.n; c++) {
+			uint64_t v = src->cnt[(size_t)r * src->x.n + c];
+			int dc, dr;
+
+			if (!v)
+				continue;
+			dc = grid_fit(dst, 0, src->x.origin + (int64_t)(c * src->x.scale));
+			dr = grid_fit(dst, 1, src->y.origin + (int64_t)(r * src->y.scale));
+			if (dc >= 0 && dr >= 0)
+				dst->cnt[(size_t)dr * dst->x.n + dc] += v;
+		}
+}
+
+// black -> blue -> red -> yellow -> white
+static void colormap(double v, unsigned char *rgb)
+{
+	static const double stop[5][3] = {
+		{ 0, 0, 0 }, { 0, 0, 200 }, { 220, 0, 0 }, { 255, 220, 0 }, { 255, 255, 255 }
+	};
+	double pos = v * 4;
+	int i = pos >= 4 ? 3 : (int)pos;
+	double f = pos - i;
+	int k;
+
+	for (k = 0; k < 3; k++)
+		rgb[k] = (unsigned char)(stop[i][k] + (stop[i+1][k] - stop[i][k]) * f);
+}
+
+static int write_ppm(const grid *g, const char *path)
+{
+	FILE *fp = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+	unsigned char *line;
+	uint64_t max = 0;
+	size_t i;
+	int r, c;
+
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+
+	for (i = 0; i < (size_t)g->x.n * g->y.n; i++)
+		if (g->cnt[i] > max)
+			max = g->cnt[i];
+
+	line = malloc((size_t)g->x.n * 3);
+	if (!line) {
+		perror("trace_heatmap : malloc");
+		exit(1);
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", g->x.n, g->y.n);
+	for (r = g->y.n - 1; r >= 0; r--) {
+		for (c = 0; c < g->x.n; c++) {
+			uint64_t v = g->cnt[(size_t)r * g->x.n + c];
+			double d = v && max ? log1p((double)v) / log1p((double)max) : 0;
+			colormap(d, line + c * 3);
+		}
+		fwrite(line, 3, g->x.n, fp);
+	}
+	free(line);
+
+	if (fp != stdout)
+		fclose(fp);
+
+	fprintf(stderr, "trace_heatmap : %dx%d, time %lld + %llu/px, LBA %lld + %llu/px, max %llu writes/px\n",
+		g->x.n, g->y.n, (long long)g->x.origin, (unsigned long long)g->x.scale,
+		(long long)g->y.origin, (unsigned long long)g->y.scale, (unsigned long long)max);
+
+	return 0;
+}
+
+static void parse_range(const char *s, int64_t *from, int64_t *to)
+{
+	const char *colon = strchr(s, ':');
+
+	if (!colon || colon == s || !colon[1]) {
+		fprintf(stderr, "trace_heatmap : range must be from:to\n");
+		exit(1);
+	}
+	*from = strtoll(s, NULL, 0);
+	*to = strtoll(colon + 1, NULL, 0);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : trace_heatmap [-W width] [-H height] [-t from:to] [-l from:to] [-f fs]"
+		" [-j threads] [-o out.ppm] trace\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = "heatmap.ppm";
+	const char *path;
+	int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int opt, i;
+	grid g;
+
+	while ((opt = getopt(argc, argv, "W:H:t:l:f:j:o:")) != -1) {
+		switch (opt) {
+		case 'W':
+			width = atoi(optarg);
+			break;
+		case 'H':
+			height = atoi(optarg);
+			break;
+		case 't':
+			parse_range(optarg, &t_from, &t_to);
+			break;
+		case 'l':
+			parse_range(optarg, &l_from, &l_to);
+			break;
+		case 'f':
+			fs_filter = optarg;
+			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	// folding needs an even number of bins
+	if (optind != argc - 1 || width < 2 || height < 2 || width % 2 || height % 2 || n_threads < 1)
+		usage();
+	path = argv[optind];
+
+	// the LBA axis is fixed by -l, the time axis is left adaptive : -t only filters
+	grid_init(&g, INT64_MIN, INT64_MAX, l_from, l_to);
+
+	if (!strcmp(path, "-")) {
+		sphw_scan_fd(STDIN_FILENO, plot, &g);
+	} else {
+		store_reader r;
+		sphw_map map;
+
+		if (sphw_store_open(&r, path) == 0) {
+			store_query q;
+
+			sphw_store_query_init(&q);
+			if (sphw_store_query(&r, &q, plot, &g) < 0)
+				fprintf(stderr, "trace_heatmap : %s is corrupted\n", path);
+			sphw_store_close(&r);
+		} else if (sphw_map_open(path, &map) == 0) {
+			worker *w = calloc(n_threads, sizeof(*w));
+			size_t *bounds = malloc((n_threads + 1) * sizeof(*bounds));
+
+			sphw_split(map.base, map.len, n_threads, bounds);
+			for (i = 0; i < n_threads; i++) {
+				w[i].begin = map.base + bounds[i];
+				w[i].end = map.base + bounds[i+1];
+				grid_init(&w[i].g, INT64_MIN, INT64_MAX, l_from, l_to);
+				if (pthread_create(&w[i].tid, NULL, render_chunk, &w[i])) {
+					perror("trace_heatmap : pthread_create");
+					return 1;
+				}
+			}
+			for (i = 0; i < n_threads; i++) {
+				pthread_join(w[i].tid, NULL);
+				grid_merge(&g, &w[i].g);
+				free(w[i].g.cnt);
+			}
+
+			free(bounds);
+			free(w);
+			sphw_map_close(&map);
+		} else {
+			perror(path);
+			return 1;
+		}
+	}
+
+	if (g.x.empty) {
+		fprintf(stderr, "trace_heatmap : no records\n");
+		return 1;
+	}
+
+	return write_ppm(&g, out) < 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * streaming trace encoder / decoder
+ *	pack   : text trace (files or stdin) -> delta coded stream (sphw_stream.h), written frame by frame,
+ *	         so it can sit at the end of a collector pipe :
+ *	             cat /proc/myproc/myproc | trace_pack -o trace.sphs
+ *	unpack : stream -> text, for tools that read text ('-')
+ *	trace_analyzer reads streams directly.
+ *
+ * usage : trace_pack [-o out] [trace...]
+ *         trace_pack -d stream...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sphw_stream.h"
+
+static stream_writer writer;
+static unsigned long long text_bytes;
+
+static int pack_rec(const sphw_rec *rec, void *arg)
+{
+	if (sphw_stream_append(&writer, rec) < 0) {
+		perror("trace_pack : write");
+		exit(1);
+	}
+	return 0;
+}
+
+static int print_rec(const sphw_rec *rec, void *arg)
+{
+	printf("time : %ld || FS_name : %.*s || block_no : %llu || size : %u || rw : 0x%lx || ns : %llu"
+		" || dev : %u,%u || pid : %d || cpu : %d || class : %s\n",
+		rec->time, rec->fs_len, rec->fs_name, rec->block_no, rec->size, rec->rw, rec->ns,
+		rec->dev >> 20, rec->dev & 0xfffff, rec->pid, rec->cpu, sphw_class_name(rec->wclass));
+	return 0;
+}
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int pack(const char *out, int argc, char *argv[])
+{
+	FILE *fp = out ? fopen(out, "wb") : stdout;
+	double start = now_sec(), sec;
+	int i;
+
+	if (!fp || sphw_stream_create(&writer, fp) < 0) {
+		perror(out ? out : "trace_pack");
+		return 1;
+	}
+
+	if (argc == 0) {
+		sphw_scan_fd(STDIN_FILENO, pack_rec, NULL);
+	} else {
+		for (i = 0; i < argc; i++) {
+			sphw_map map;
+
+			if (sphw_map_open(argv[i], &map) < 0) {
+				perror(argv[i]);
+				return 1;
+			}
+			sphw_scan(map.base, map.base + map.len, pack_rec, NULL);
+			text_bytes += map.len;
+			sphw_map_close(&map);
+		}
+	}
+
+	if (sphw_stream_finish(&writer) < 0 || (fp != stdout && fclose(fp))) {
+		perror("trace_pack : write");
+		return 1;
+	}
+
+	sec = now_sec() - start;
+	fprintf(stderr, "trace_pack : %llu records, %llu bytes (%.1f bytes/record",
+		writer.records, writer.bytes, writer.records ? (double)writer.bytes / writer.records : 0.0);
+	if (text_bytes)
+		fprintf(stderr, ", %.1fx smaller than text", (double)text_bytes / writer.bytes);
+	fprintf(stderr, "), %.0f records/s\n", sec > 0 ? writer.records / sec : 0.0);
+
+	return 0;
+}
+
+static int unpack(int argc, char *argv[])
+{
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		sphw_map map;
+
+		if (sphw_map_open(argv[i], &map) < 0) {
+			perror(argv[i]);
+			return 1;
+		}
+		if (!sphw_stream_is(map.base, map.len) ||
+		    sphw_stream_scan(map.base + STREAM_MAGIC_LEN, map.base + map.len, print_rec, NULL) < 0) {
+			fprintf(stderr, "trace_pack : %s is not a trace stream or is corrupted\n", argv[i]);
+			sphw_map_close(&map);
+			return 1;
+		}
+		sphw_map_close(&map);
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : trace_pack [-o out] [trace...]\n"
+		"        trace_pack -d stream...\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL;
+	int opt, dec = 0;
+
+	while ((opt = getopt(argc, argv, "o:d")) != -1) {
+		switch (opt) {
+		case 'o':
+			out = optarg;
+			break;
+		case 'd':
+			dec = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (dec)
+		return optind < argc ? unpack(argc - optind, argv + optind) : (usage(), 1);
+	if (!out && isatty(STDOUT_FILENO))
+		usage();
+
+	return pack(out, argc - optind, argv + optind);
+}
@@ -0,0 +1,217 @@
+/*
+ * trace store tool
+ *	pack  : text trace (file or stdin) -> columnar store
+ *	query : records of a store matching time / LBA / flag / fs filters, as text
+ *	info  : blocks and index of a store
+ *
+ * usage : trace_store pack store.sphc [trace.txt...]
+ *         cat /proc/myproc/myproc | trace_store pack store.sphc
+ *         trace_store query store.sphc [-t from:to] [-l from:to] [-w] [-F flags] [-f fs]
+ *         trace_store info store.sphc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sphw_store.h"
+
+static store_writer writer;
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage : trace_store pack store.sphc [trace.txt...]\n"
+		"        trace_store query store.sphc [-t from:to] [-l from:to] [-w] [-F flags] [-f fs]\n"
+		"        trace_store info store.sphc\n");
+	exit(1);
+}
+
+static int pack_rec(const sphw_rec *rec, void *arg)
+{
+	if (sphw_store_append(&writer, rec) < 0) {
+		perror("trace_store : write");
+		exit(1);
+	}
+	return 0;
+}
+
+static int pack(int argc, char *argv[])
+{
+	unsigned long long n = 0;
+	int i;
+
+	if (argc < 1)
+		usage();
+
+	if (sphw_store_create(&writer, argv[0]) < 0) {
+		perror(argv[0]);
+		return 1;
+	}
+
+	if (argc == 1)
+		n = sphw_scan_fd(STDIN_FILENO, pack_rec, NULL);
+
+	for (i = 1; i < argc; i++) {
+		sphw_map map;
+
+		if (sphw_map_open(argv[i], &map) < 0) {
+			perror(argv[i]);
+			return 1;
+		}
+		n += sphw_scan(map.base, map.base + map.len, pack_rec, NULL);
+		sphw_map_close(&map);
+	}
+
+	if (sphw_store_finish(&writer) < 0) {
+		perror("trace_store : write");
+		return 1;
+	}
+
+	fprintf(stderr, "trace_store : %llu records packed into %s\n", n, argv[0]);
+
+	return 0;
+}
+
+// same format as /proc/myproc/myproc, without padding
+static int print_rec(const sphw_rec *rec, void *arg)
+{
+	printf("time : %ld || FS_name : %.*s || block_no : %llu || size : %u || rw : 0x%lx || ns : %llu\n",
+		rec->time, rec->fs_len, rec->fs_name, rec->block_no, rec->size, rec->rw, rec->ns);
+	return 0;
+}
+
+// "from:to", either side can be empty
+static void parse_range(const char *s, uint64_t *from, uint64_t *to)
+{
+	const char *colon = strchr(s, ':');
+
+	if (!colon)
+		usage();
+	if (colon != s)
+		*from = strtoull(s, NULL, 0);
+	if (colon[1])
+		*to = strtoull(colon + 1, NULL, 0);
+}
+
+static int query(int argc, char *argv[])
+{
+	store_reader r;
+	store_query q;
+	const char *fs = NULL;
+	uint64_t t_from = 0, t_to = INT64_MAX;
+	long long n;
+	int opt;
+
+	if (argc < 2)
+		usage();
+
+	sphw_store_query_init(&q);
+
+	optind = 1;
+	while ((opt = getopt(argc, argv, "t:l:wF:f:")) != -1) {
+		switch (opt) {
+		case 't':
+			parse_range(optarg, &t_from, &t_to);
+			q.t_from = t_from;
+			q.t_to = t_to;
+			break;
+		case 'l':
+			parse_range(optarg, &q.lba_from, &q.lba_to);
+			break;
+		case 'w':
+			q.rw_mask |= REQ_WRITE;
+			break;
+		case 'F':
+			q.rw_mask |= strtoull(optarg, NULL, 0);
+			break;
+		case 'f':
+			fs = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+
+	if (sphw_store_open(&r, argv[optind]) < 0) {
+		fprintf(stderr, "trace_store : can't open store %s\n", argv[optind]);
+		return 1;
+	}
+
+	if (fs) {
+		q.fs_id = sphw_store_fs_id(&r, fs);
+		if (q.fs_id < 0) {
+			sphw_store_close(&r);
+			return 0;
+		}
+	}
+
+	n = sphw_store_query(&r, &q, print_rec, NULL);
+	sphw_store_close(&r);
+
+	if (n < 0) {
+		fprintf(stderr, "trace_store : %s is corrupted\n", argv[optind]);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int info(int argc, char *argv[])
+{
+	store_reader r;
+	unsigned long long records = 0;
+	uint64_t i;
+	int f;
+
+	if (argc != 1)
+		usage();
+
+	if (sphw_store_open(&r, argv[0]) < 0) {
+		fprintf(stderr, "trace_store : can't open store %s\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-6s %12s %10s %8s %12s %12s %14s %14s %10s\n",
+		"BLOCK", "OFFSET", "BYTES", "RECORDS", "MIN_TIME", "MAX_TIME", "MIN_LBA", "MAX_LBA", "RW_OR");
+	for (i = 0; i < r.nblocks; i++) {
+		const store_index *ix = &r.index[i];
+		printf("%-6llu %12llu %10u %8u %12lld %12lld %14llu %14llu %#10llx\n",
+			(unsigned long long)i, (unsigned long long)ix->offset, ix->len, ix->nrec,
+			(long long)ix->min_time, (long long)ix->max_time,
+			(unsigned long long)ix->min_sector, (unsigned long long)ix->max_sector,
+			(unsigned long long)ix->rw_or);
+		records += ix->nrec;
+	}
+
+	printf("\nfile systems :");
+	for (f = 0; f < r.nfs; f++)
+		printf(" %s", r.fs[f][0] ? r.fs[f] : "-");
+	printf("\n%llu records in %llu blocks, %zu bytes (%.2f bytes/record)\n",
+		records, (unsigned long long)r.nblocks, r.map.len,
+		records ? (double)r.map.len / records : 0.0);
+
+	sphw_store_close(&r);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+		usage();
+
+	if (!strcmp(argv[1], "pack"))
+		return pack(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "query"))
+		return query(argc - 1, argv + 1);
+	if (!strcmp(argv[1], "info"))
+		return info(argc - 2, argv + 2);
+
+	usage();
+	return 1;
+}
@@ -0,0 +1,223 @@
+/*
+ * fixed O_DIRECT write workload for measuring the submit_bio() hook
+ *	every thread writes io_size blocks into its own slice of the target with pwrite(O_DIRECT),
+ *	so each write is one bio submitted from the writer's context.
+ *
+ * usage : bio_bench -f target [-j threads] [-s io size] [-t seconds] [-r]
+ * output : iops=... ns_per_io=... cpu_ns_per_io=... cycles_per_io=...
+ *	cpu_ns_per_io is user + system time of all writers per write,
+ *	cycles_per_io is "-" when perf events are not available.
+ */
+
+#define _GNU_SOURCE		// O_DIRECT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <linux/perf_event.h>
+
+#define ALIGN 4096
+
+typedef struct _writer
+{
+	pthread_t tid;
+	int fd;
+	uint64_t base, len;		// slice of the target
+	uint64_t ios;			// writes done
+}writer;
+
+static size_t io_size = 4096;
+static int seconds = 10;
+static int random_io;
+static volatile int stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *write_loop(void *arg)
+{
+	writer *w = arg;
+	uint64_t blocks = w->len / io_size;
+	uint64_t seed = (w->base / ALIGN) * 2654435761ULL | 1;
+	uint64_t i = 0;
+	void *buf;
+
+	if (posix_memalign(&buf, ALIGN, io_size)) {
+		perror("bio_bench : posix_memalign");
+		exit(1);
+	}
+	memset(buf, 0x5a, io_size);
+
+	while (!stop) {
+		uint64_t blk;
+
+		if (random_io) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			blk = seed % blocks;
+		} else {
+			blk = i++ % blocks;
+		}
+
+		if (pwrite(w->fd, buf, io_size, w->base + blk * io_size) != (ssize_t)io_size) {
+			perror("bio_bench : pwrite");
+			exit(1);
+		}
+		w->ios++;
+	}
+
+	free(buf);
+	return NULL;
+}
+
+// cpu cycles of this process and its threads, user and kernel
+static int open_cycles(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.inherit = 1;
+	attr.disabled = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t target_size(int fd)
+{
+	struct stat st;
+	uint64_t size = 0;
+
+	if (fstat(fd, &st) < 0)
+		return 0;
+	if (S_ISBLK(st.st_mode)) {
+		if (ioctl(fd, BLKGETSIZE64, &size) < 0)
+			return 0;
+		return size;
+	}
+	return st.st_size;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage : bio_bench -f target [-j threads] [-s io size] [-t seconds] [-r]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	writer *w;
+	struct rusage ru;
+	uint64_t size, slice, start, elapsed, ios = 0, cycles = 0, cpu_ns;
+	int fd, perf_fd, opt, i;
+
+	while ((opt = getopt(argc, argv, "f:j:s:t:r")) != -1) {
+		switch (opt) {
+		case 'f':
+			path = optarg;
+			break;
+		case 'j':
+			n_threads = atoi(optarg);
+			break;
+		case 's':
+			io_size = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			random_io = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!path || n_threads < 1 || io_size == 0 || io_size % 512 || seconds < 1)
+		usage();
+
+	fd = open(path, O_WRONLY | O_DIRECT);
+	if (fd < 0) {
+		perror(path);
+		return 1;
+	}
+
+	size = target_size(fd);
+	slice = size / n_threads / ALIGN * ALIGN;
+	if (slice < io_size) {
+		fprintf(stderr, "bio_bench : %s is too small\n", path);
+		return 1;
+	}
+
+	perf_fd = open_cycles();
+	if (perf_fd >= 0)
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+
+	w = calloc(n_threads, sizeof(*w));
+	start = now_ns();
+	for (i = 0; i < n_threads; i++) {
+		w[i].fd = fd;
+		w[i].base = slice * i;
+		w[i].len = slice;
+		if (pthread_create(&w[i].tid, NULL, write_loop, &w[i])) {
+			perror("bio_bench : pthread_create");
+			return 1;
+		}
+	}
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < n_threads; i++) {
+		pthread_join(w[i].tid, NULL);
+		ios += w[i].ios;
+	}
+	elapsed = now_ns() - start;
+
+	if (perf_fd >= 0) {
+		ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(perf_fd, &cycles, sizeof(cycles)) != sizeof(cycles))
+			cycles = 0;
+		close(perf_fd);
+	}
+
+	getrusage(RUSAGE_SELF, &ru);
+	cpu_ns = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+
+	if (ios == 0) {
+		fprintf(stderr, "bio_bench : no write completed\n");
+		return 1;
+	}
+
+	printf("iops=%.0f ns_per_io=%.1f cpu_ns_per_io=%.1f ",
+		ios * 1e9 / elapsed, (double)elapsed * n_threads / ios, (double)cpu_ns / ios);
+	if (cycles)
+		printf("cycles_per_io=%.0f\n", (double)cycles / ios);
+	else
+		printf("cycles_per_io=-\n");
+
+	free(w);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+#!/bin/bash
+# ext4 vs F2FS benchmark suite
+#	creates a file system image on a loop device for each file system,
+#	runs the fio workloads in ./workloads on it,
+#	and collects the sphw trace of /proc/myproc/myproc for each run.
+#
+# usage : sudo ./run_bench.sh [-f "ext4 f2fs"] [-w "seq rand fsync smallfile"]
+#                             [-s image size(MB)] [-n runs] [-o result dir]
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+PROC_FILE=/proc/myproc/myproc
+AGE_FILE=/proc/myproc/age			# dirty age histogram, per file system
+CLASS_FILE=/proc/myproc/class		# bytes of each write class, per file system
+ANALYZER=$BENCH_DIR/../analyzer/trace_analyzer	# detailed report of each trace, if built
+
+FS_LIST="ext4 f2fs"			# file systems to compare
+WORKLOADS=""				# workloads to run, default : all of ./workloads
+IMG_SIZE=1024				# size of file system image (MB)
+RUNS=1					# repetitions of each workload
+OUT_DIR=./result			# where traces and summary are stored
+SEQ_GAP=2048				# max forward jump (sectors) still counted as sequential
+
+while getopts "f:w:s:n:o:" opt; do
+	case $opt in
+		f) FS_LIST=$OPTARG ;;
+		w) WORKLOADS=$OPTARG ;;
+		s) IMG_SIZE=$OPTARG ;;
+		n) RUNS=$OPTARG ;;
+		o) OUT_DIR=$OPTARG ;;
+		*) sed -n '2,9p' "$0"; exit 1 ;;
+	esac
+done
+
+if [ -z "$WORKLOADS" ]; then
+	WORKLOADS=$(ls "$BENCH_DIR"/workloads/*.fio | xargs -n1 basename | sed 's/\.fio$//')
+fi
+
+# check environment
+if [ "$(id -u)" -ne 0 ]; then
+	echo "run_bench : must be run as root"
+	exit 1
+fi
+for tool in fio losetup mkfs.ext4 mkfs.f2fs; do
+	if ! command -v $tool > /dev/null; then
+		echo "run_bench : $tool not found"
+		exit 1
+	fi
+done
+if [ ! -e $PROC_FILE ]; then
+	echo "run_bench : $PROC_FILE not found, insmod myproc.ko first"
+	exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+IMG=$OUT_DIR/fs.img
+MNT=$OUT_DIR/mnt
+LOOP=""
+
+# remove loop device and image even if interrupted
+cleanup() {
+	mountpoint -q "$MNT" && umount "$MNT"
+	[ -n "$LOOP" ] && losetup -d "$LOOP"
+	rm -f "$IMG"
+	LOOP=""
+}
+trap 'cleanup; exit 1' INT TERM
+
+# stream the circular queue into $1 while the workload runs
+#	every open of $PROC_FILE has its own cursor : records already in the queue
+#	are skipped, then new ones are read every 0.1s, before the queue (q_MAX, 1000) wraps.
+#	records overwritten before they were read show up as "lost : N" lines.
+start_trace() {
+	exec 3< $PROC_FILE
+	cat <&3 > /dev/null
+	( while [ ! -e "$1.stop" ]; do cat <&3; sleep 0.1; done; cat <&3 ) > "$1" &
+	TRACE_PID=$!
+}
+
+stop_trace() {
+	touch "$1.stop"
+	wait $TRACE_PID
+	rm -f "$1.stop"
+	exec 3<&-
+}
+
+# keep records of $2 from the stream $1, count lost records
+collect_trace() {
+	awk -v fs="$2" -v lost="$1.lost" '
+		$1 == "lost" { n += $3; next }
+		$7 == fs
+		END { print n + 0 > lost }' "$1"
+}
+
+# summary of a trace : records, sequentiality
+#	a write is sequential if it lands at most SEQ_GAP sectors after the previous one
+trace_summary() {
+	sort -n -k3,3 -s "$1" | awk -v gap=$SEQ_GAP '
+		{
+			blk = $11
+			if (n > 0 && blk > prev && blk - prev <= gap)
+				seq++
+			prev = blk
+			n++
+		}
+		END { printf "%d %.1f", n, (n > 1 ? 100.0 * seq / (n - 1) : 0) }'
+}
+
+SUMMARY=$OUT_DIR/summary.txt
+printf "%-6s %-10s %-4s %12s %10s %12s %8s %6s %6s\n" \
+	"FS" "WORKLOAD" "RUN" "BW(KiB/s)" "IOPS" "LAT(usec)" "RECORDS" "SEQ%" "LOST" > "$SUMMARY"
+
+for fs in $FS_LIST; do
+	for wl in $WORKLOADS; do
+		for run in $(seq 1 $RUNS); do
+			tag=${fs}_${wl}_${run}
+			echo "run_bench : $tag"
+
+			# make a fresh file system on a loop device
+			truncate -s ${IMG_SIZE}M "$IMG"
+			LOOP=$(losetup -f --show "$IMG")
+			if [ "$fs" = "f2fs" ]; then
+				mkfs.f2fs -f "$LOOP" > /dev/null
+			else
+				mkfs.$fs -F -q "$LOOP"
+			fi
+			mkdir -p "$MNT"
+			mount -t $fs "$LOOP" "$MNT"
+
+			sync
+			echo 3 > /proc/sys/vm/drop_caches
+			echo 1 > $AGE_FILE
+			echo 1 > $CLASS_FILE
+			start_trace "$OUT_DIR/$tag.raw"
+
+			# run workload
+			#	terse v3 : 48 -> write bw(KiB/s), 49 -> write iops, 81 -> write lat mean(usec)
+			fio --directory="$MNT" --output-format=terse --terse-version=3 \
+				--group_reporting "$BENCH_DIR/workloads/$wl.fio" > "$OUT_DIR/$tag.fio"
+			sync
+			stop_trace "$OUT_DIR/$tag.raw"
+			cat $AGE_FILE > "$OUT_DIR/$tag.age"
+			cat $CLASS_FILE > "$OUT_DIR/$tag.class"
+
+			collect_trace "$OUT_DIR/$tag.raw" $fs > "$OUT_DIR/$tag.txt"
+			lost=$(cat "$OUT_DIR/$tag.raw.lost")
+			rm -f "$OUT_DIR/$tag.raw" "$OUT_DIR/$tag.raw.lost"
+			if [ -x "$ANALYZER" ]; then
+				"$ANALYZER" -g $SEQ_GAP "$OUT_DIR/$tag.txt" > "$OUT_DIR/$tag.analysis"
+			fi
+
+			cleanup
+
+			read bw iops lat <<< $(tail -n1 "$OUT_DIR/$tag.fio" | awk -F';' '{ print $48, $49, $81 }')
+			read records seq <<< $(trace_summary "$OUT_DIR/$tag.txt")
+			printf "%-6s %-10s %-4s %12s %10s %12s %8s %6s %6s\n" \
+				$fs $wl $run $bw $iops $lat $records $seq $lost >> "$SUMMARY"
+		done
+	done
+done
+
+rmdir "$MNT" 2> /dev/null
+cat "$SUMMARY"
@@ -0,0 +1,139 @@
+#!/bin/bash
+# overhead of the submit_bio() tracer
+#	runs bio_bench (parallel O_DIRECT writers) with the tracer in each mode of /proc/myproc/ctl
+#	and compares it with the tracer off.
+#	by default the target is a file on an ext4 image in /dev/shm, mounted through a loop device,
+#	so that every bio has a file system (bd_super) as in real captures.
+#
+# usage : sudo ./tracer_overhead.sh [-m "off stats on sample:16 filter:f2fs"] [-f target]
+#                                   [-j threads] [-t seconds] [-n runs] [-b budget(ns/bio)]
+#	mode : off, stats (counters only), on, sample:N (record 1 out of N writes), filter:FS (record FS only)
+#	budget : fail (exit 1) if a mode costs more cpu ns per bio than off + budget
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+CTL=/proc/myproc/ctl
+BIO_BENCH=$BENCH_DIR/bio_bench
+
+MODES="off stats on sample:16 filter:f2fs"
+TARGET=""				# file or block device, default : ext4 on a loop device
+THREADS=$(( $(nproc) * 2 ))
+SECONDS_PER_RUN=10
+RUNS=3
+BUDGET=""
+
+while getopts "m:f:j:t:n:b:" opt; do
+	case $opt in
+		m) MODES=$OPTARG ;;
+		f) TARGET=$OPTARG ;;
+		j) THREADS=$OPTARG ;;
+		t) SECONDS_PER_RUN=$OPTARG ;;
+		n) RUNS=$OPTARG ;;
+		b) BUDGET=$OPTARG ;;
+		*) sed -n '2,12p' "$0"; exit 1 ;;
+	esac
+done
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "tracer_overhead : must be run as root"
+	exit 1
+fi
+if [ ! -e $CTL ]; then
+	echo "tracer_overhead : $CTL not found, insmod myproc.ko first"
+	exit 1
+fi
+if [ ! -x "$BIO_BENCH" ]; then
+	make -C "$BENCH_DIR" bio_bench > /dev/null || exit 1
+fi
+
+IMG=/dev/shm/sphw_overhead.img
+MNT=/tmp/sphw_overhead
+LOOP=""
+
+cleanup() {
+	mountpoint -q $MNT && umount $MNT
+	[ -n "$LOOP" ] && losetup -d $LOOP
+	rm -f $IMG
+	LOOP=""
+	# leave the tracer as it is after boot
+	echo on > $CTL
+	echo sample 1 > $CTL
+	echo filter > $CTL
+}
+trap 'cleanup; exit 1' INT TERM
+
+if [ -z "$TARGET" ]; then
+	truncate -s 1G $IMG
+	LOOP=$(losetup -f --show $IMG)
+	mkfs.ext4 -F -q $LOOP
+	mkdir -p $MNT
+	mount -t ext4 $LOOP $MNT
+	TARGET=$MNT/bench.dat
+	fallocate -l 768M $TARGET
+fi
+
+# set tracer mode $1
+set_mode() {
+	echo sample 1 > $CTL
+	echo filter > $CTL
+	case $1 in
+		off)		echo off > $CTL ;;
+		on)			echo on > $CTL ;;
+		stats)		echo stats > $CTL ;;
+		sample:*)	echo on > $CTL; echo "sample ${1#sample:}" > $CTL ;;
+		filter:*)	echo on > $CTL; echo "filter ${1#filter:}" > $CTL ;;
+		*)			echo "tracer_overhead : unknown mode $1"; cleanup; exit 1 ;;
+	esac
+}
+
+# mean of each bio_bench field over RUNS runs of mode $1
+measure() {
+	set_mode $1
+	for run in $(seq 1 $RUNS); do
+		"$BIO_BENCH" -f "$TARGET" -j $THREADS -t $SECONDS_PER_RUN || { cleanup; exit 1; }
+	done | awk '
+		{
+			for (i = 1; i <= NF; i++) {
+				split($i, kv, "=")
+				if (kv[2] != "-") { sum[kv[1]] += kv[2]; cnt[kv[1]]++ }
+			}
+		}
+		END {
+			if (!cnt["iops"])
+				exit 1
+			printf "%.0f %.1f %.1f %s\n", sum["iops"] / cnt["iops"],
+				sum["ns_per_io"] / cnt["ns_per_io"], sum["cpu_ns_per_io"] / cnt["cpu_ns_per_io"],
+				cnt["cycles_per_io"] ? sprintf("%.0f", sum["cycles_per_io"] / cnt["cycles_per_io"]) : "-"
+		}'
+}
+
+echo "tracer_overhead : $THREADS writers, ${SECONDS_PER_RUN}s x $RUNS runs on $TARGET"
+read base_iops base_ns base_cpu base_cyc <<< $(measure off)
+
+printf "%-14s %10s %8s %12s %12s %10s %12s %10s\n" \
+	"MODE" "IOPS" "dIOPS%" "NS/IO" "CPU_NS/IO" "dNS/BIO" "CYCLES/IO" "dCYC/BIO"
+fail=0
+for mode in $MODES; do
+	if [ "$mode" = "off" ]; then
+		iops=$base_iops; ns=$base_ns; cpu=$base_cpu; cyc=$base_cyc
+	else
+		read iops ns cpu cyc <<< $(measure $mode)
+	fi
+
+	read diops dcpu dcyc <<< $(awk -v bi=$base_iops -v i=$iops -v bc=$base_cpu -v c=$cpu \
+		-v by=$base_cyc -v y=$cyc 'BEGIN {
+			printf "%.1f %.1f %s\n", 100.0 * (i - bi) / bi, c - bc,
+				(y == "-" || by == "-") ? "-" : sprintf("%.0f", y - by) }')
+
+	verdict=""
+	if [ -n "$BUDGET" ] && [ "$mode" != "off" ] && \
+	   awk -v d=$dcpu -v b=$BUDGET 'BEGIN { exit !(d > b) }'; then
+		verdict="  OVER BUDGET"
+		fail=1
+	fi
+
+	printf "%-14s %10s %8s %12s %12s %10s %12s %10s%s\n" \
+		$mode $iops $diops $ns $cpu $dcpu $cyc $dcyc "$verdict"
+done
+
+cleanup
+exit $fail
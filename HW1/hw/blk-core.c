@@ -36,12 +36,6 @@
 
 #define CREATE_TRACE_POINTS
 
-//	writer : Yun Yurim
-//	begin modifying
-#include <linux/time.h>
-#define q_MAX 1000
-//	end modifying
-
 #include <trace/events/block.h>
 
 #include "blk.h"
@@ -2102,31 +2096,9 @@ EXPORT_SYMBOL(generic_make_request);
 
 //	writer : Yun Yurim
 //	begin modifying
-
-// struct for hw1
-//		entry of a circular queue
-typedef struct _sphw
-{
-	const char* fs_name;			// file system name : ext4 / f2fs
-	long time;						// write time
-	unsigned long long block_no;	// block number
-}sphw;
-
-sphw c_q[q_MAX];					// the circular queue
-EXPORT_SYMBOL(c_q);					// for proc file
-
-int q_front = 0;					// front of the circular queue
-EXPORT_SYMBOL(q_front);				// for proc file
-
-// function for the circular queue
-//		insert sphw at the front of the circular queue
-void push_cq(sphw new_sphw)
-{
-	c_q[q_front] = new_sphw;
-	q_front = (q_front+1)%q_MAX;	// circular
-	return;
-}
-EXPORT_SYMBOL(push_cq);				// for proc file
+// the tracer : record layout and capture, shared with lkm/sphw_kprobe.c
+#define SPHW_CAPTURE
+#include "sphw_capture.h"
 //	end modifying
 
 
@@ -2151,35 +2123,7 @@ blk_qc_t submit_bio(int rw, struct bio *bio)
 		if (rw & WRITE) {
 			count_vm_events(PGPGOUT, count);
 
-			sphw new_sphw;
-			if(bio == NULL)
-			{
-				printk(KERN_WARNING "No Bio!!\n");
-			} else {
-
-				// get write time
-				struct timespec now_t;
-				getnstimeofday(&now_t);
-			
-				// get file system name
-				//		warning : super block could be NULL
-				if(bio->bi_bdev->bd_super != NULL)
-				{
-					new_sphw.fs_name = bio->bi_bdev->bd_super->s_type->name;
- 				} else {
-					new_sphw.fs_name = "";
-					printk(KERN_WARNING "No File System Name!!\n");
-				}
-
-				new_sphw.time = now_t.tv_sec;
-
-				// get block number
-				new_sphw.block_no = bio->bi_iter.bi_sector;
-
-				// push information into circular queue
-				push_cq(new_sphw);
-
-			}
+			sphw_capture(bio, rw);
 		// end modifying
 
 		} else {
@@ -2196,7 +2140,14 @@ blk_qc_t submit_bio(int rw, struct bio *bio)
 				bdevname(bio->bi_bdev, b),
 				count);
 		}
+
+	//	writer : Yun Yurim
+	//	begin modifying
+	// writes without data : flushes, discards, for the counters
+	} else if (rw & WRITE) {
+		sphw_capture(bio, rw);
 	}
+	//	end modifying
 
 	return generic_make_request(bio);
 }
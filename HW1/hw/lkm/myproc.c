@@ -6,79 +6,424 @@ writer : Yun Yurim
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/proc_fs.h>
+#include <linux/string.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 #include <asm/uaccess.h>
 
+#include "sphw_capture.h"	// layout of the records and counters of the tracer
+
 #define PROC_DIRNAME "myproc"
 #define PROC_FILENAME "myproc"
+#define PROC_CTLNAME "ctl"		// tracer mode : off / on / stats / sample N / filter FS
+#define PROC_AGENAME "age"		// dirty age histogram of each file system
+#define PROC_CLASSNAME "class"	// bytes of each write class of each file system
+#define PROC_STATNAME "stats"	// write counters, one line per device
 
-#define q_MAX 1000
+#define RESULT_LEN 224		// length of one formatted record
+#define LOST_LEN 32			// length of a "lost : N" line
+#define CTL_BUFSIZE 64
+#define STAT_BUFSIZE 4096
 
 static struct proc_dir_entry *proc_dir;
 static struct proc_dir_entry *proc_file;
+static struct proc_dir_entry *ctl_file;
+static struct proc_dir_entry *age_file;
+static struct proc_dir_entry *class_file;
+static struct proc_dir_entry *stat_file;
 
-// to use kernel's circular queue
-typedef struct _sphw
-{
-	const char* fs_name;			// file system name : ext4 / f2fs
-	long time;						// write time
-	unsigned long long block_no;	// block number
-}sphw;
-
+// names of write classes, in the order of SPHW_DATA, SPHW_NODE ... in kernel
+static const char *class_name[SPHW_CLASSES] = { "data", "node", "meta", "gc", "journal" };
 
-extern sphw c_q[q_MAX];				// the circular queue in kernel
-extern int q_front;					// front of the circular queue, also in kernel
-extern void push_cq(sphw value);	// function for the circular queue
-									// 		insert sphw at the front of the circular queue
-									//		also in kernel
+// reader of the circular queue, one per open file
+//		readers share c_q, each one only keeps where it is
+typedef struct _cursor
+{
+	unsigned long long next;		// sequence number of the next record to read
+	unsigned long long lost;		// records overwritten before this reader got them
+	char line[LOST_LEN + RESULT_LEN];	// formatted record not fully copied yet
+	int len, off;
+}cursor;
+
+// oldest record still in the queue
+static unsigned long long oldest_seq(void)
+{
+	unsigned long long seq = atomic64_read(&q_seq);
 
-// buffer for copying information proc file in kernel to userspace
-char result[q_MAX][100];
+	return seq > q_MAX ? seq - q_MAX : 0;
+}
 
-// customized open : open proc file
+// customized open : open proc file, start from the oldest record in the queue
 static int my_open(struct inode *inode, struct file *file)
 {
+	cursor *cur;
+
 	printk(KERN_INFO "Simple Module Open!!\n");
 
+	cur = kzalloc(sizeof(*cur), GFP_KERNEL);
+	if(cur == NULL)
+	{
+		return -ENOMEM;
+	}
+	cur->next = oldest_seq();
+	file->private_data = cur;
+
+	return nonseekable_open(inode, file);
+}
+
+static int my_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+
 	return 0;
 }
 
-// customized write : write sphw info to proc file
+// customized write : go back to the oldest record in the queue
+//		records used to be buffered here, now they are formatted in my_read
 static ssize_t my_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
 {
-	int i;
+	cursor *cur = file->private_data;
+
 	printk(KERN_INFO "Simple Module Write!!\n");
 
-	// Buffering
-	// 		Pop queue from front to front-1, as there's no information of q_rear
-	for(i = q_front ; i != (q_front-1 >= 0 ? q_front-1 : q_front-1+q_MAX) ; i=(i+1)%q_MAX)
+	cur->next = oldest_seq();
+	cur->len = cur->off = 0;
+
+	return count;
+}
+
+// format the next record of cur into cur->line
+//		records overwritten before they were read are reported in the stream, where they were lost,
+//		as a "lost : N" line. it has no block_no, analyzers skip it.
+//		returns 0 if there is nothing new to read
+static int next_line(cursor *cur)
+{
+	unsigned long long seq = atomic64_read(&q_seq);
+	unsigned long long lost = 0;
+	sphw rec;
+	int slot;
+
+	cur->len = cur->off = 0;
+
+	while (cur->next < seq)
 	{
-		sprintf(result[i], "time : %ld || FS_name : %s || block_no : %llu\n",c_q[i].time, c_q[i].fs_name, c_q[i].block_no);
+		// lapped by writers : skip to the oldest record
+		if (seq - cur->next > q_MAX)
+		{
+			lost += seq - q_MAX - cur->next;
+			cur->next = seq - q_MAX;
+		}
+
+		slot = cur->next % q_MAX;
+		if (READ_ONCE(c_q_seq[slot]) <= cur->next)
+			break;			// still being written : try again later
+
+		smp_rmb();
+		rec = c_q[slot];
+		smp_rmb();
+		if (READ_ONCE(c_q_seq[slot]) != cur->next + 1)
+		{
+			// overwritten while (or before) it was copied
+			lost++;
+			cur->next++;
+			continue;
+		}
+		cur->next++;
+
+		// scnprintf : len stays inside line[] even if a record is cut
+		if (lost)
+			cur->len = scnprintf(cur->line, LOST_LEN, "lost : %llu\n", lost);
+		cur->len += scnprintf(cur->line + cur->len, sizeof(cur->line) - cur->len,
+			"time : %ld || FS_name : %s || block_no : %llu || size : %u || rw : 0x%lx || ns : %llu"
+			" || dev : %u,%u || pid : %d || cpu : %d || class : %s\n",
+			rec.time, rec.fs_name, rec.block_no, rec.size, rec.rw, rec.ns,
+			MAJOR(rec.dev), MINOR(rec.dev), rec.pid, rec.cpu, class_name[rec.wclass]);
+		cur->lost += lost;
+		return 1;
 	}
 
-	return count;
+	if (lost)
+	{
+		cur->len = scnprintf(cur->line, LOST_LEN, "lost : %llu\n", lost);
+		cur->lost += lost;
+		return 1;
+	}
+
+	return 0;
 }
 
 // customized read : read sphw info to proc file
+//		copies records from the cursor of this file, returns 0 when it caught up with writers
 static ssize_t my_read(struct file *file, char __user *user_buffer, size_t count, loff_t *ppos)
 {
-	printk(KERN_INFO "Simple Module Read!!\n");
+	cursor *cur = file->private_data;
+	size_t done = 0;
 
-	// Read buffered information
-	//		Copying information in proc file to userspace
-	if(copy_to_user(user_buffer, result, sizeof(result)))
+	while (done < count)
 	{
-		return -EFAULT;
+		size_t n;
+
+		if (cur->off == cur->len && !next_line(cur))
+			break;
+
+		n = min(count - done, (size_t)(cur->len - cur->off));
+		if(copy_to_user(user_buffer + done, cur->line + cur->off, n))
+		{
+			return done ? done : -EFAULT;
+		}
+		cur->off += n;
+		done += n;
 	}
 
-	return count;
+	return done;
 }
 
 // overloading
 static const struct file_operations myproc_fops = {
 	.owner = THIS_MODULE,
 	.open = my_open,
+	.release = my_release,
 	.write = my_write,
 	.read = my_read,
+	.llseek = no_llseek,
+};
+
+static const char *mode_name(void)
+{
+	return sphw_mode == SPHW_OFF ? "off" : sphw_mode == SPHW_STATS ? "stats" : "on";
+}
+
+// customized read : show tracer mode
+static ssize_t ctl_read(struct file *file, char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	char buf[CTL_BUFSIZE];
+	int len;
+
+	len = scnprintf(buf, sizeof(buf), "%s sample %u filter %s\n",
+		mode_name(), sphw_sample, sphw_filter[0] ? sphw_filter : "-");
+
+	return simple_read_from_buffer(user_buffer, count, ppos, buf, len);
+}
+
+// customized write : change tracer mode
+//		"off", "on", "stats" (counters only), "sample N" (1 : every write), "filter FS" ("filter" : all file systems)
+static ssize_t ctl_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	char buf[CTL_BUFSIZE];
+	char fs[SPHW_FS_LEN];
+	unsigned int n;
+	size_t len = min(count, sizeof(buf) - 1);
+
+	if(copy_from_user(buf, user_buffer, len))
+	{
+		return -EFAULT;
+	}
+	buf[len] = '\0';
+
+	if(!strncmp(buf, "off", 3))
+	{
+		sphw_mode = SPHW_OFF;
+	} else if(!strncmp(buf, "on", 2)) {
+		sphw_mode = SPHW_ON;
+	} else if(!strncmp(buf, "stats", 5)) {
+		sphw_mode = SPHW_STATS;
+	} else if(sscanf(buf, "sample %u", &n) == 1 && n > 0) {
+		sphw_sample = n;
+	} else if(!strncmp(buf, "filter", 6)) {
+		if(sscanf(buf + 6, "%15s", fs) == 1)
+		{
+			strlcpy(sphw_filter, fs, SPHW_FS_LEN);
+		} else {
+			sphw_filter[0] = '\0';
+		}
+	} else {
+		return -EINVAL;
+	}
+
+	printk(KERN_INFO "Simple Module Mode : %s sample %u filter %s\n",
+		mode_name(), sphw_sample, sphw_filter[0] ? sphw_filter : "-");
+
+	return count;
+}
+
+static const struct file_operations ctl_fops = {
+	.owner = THIS_MODULE,
+	.read = ctl_read,
+	.write = ctl_write,
+};
+
+// customized read : dirty age histogram, one line per file system
+//		columns are upper bounds of the buckets (ms), the last one has no bound
+static ssize_t age_read(struct file *file, char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	char *buf;
+	ssize_t ret;
+	int len, n, fs, b, cpu;
+
+	buf = kmalloc(STAT_BUFSIZE, GFP_KERNEL);
+	if(buf == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	len = scnprintf(buf, STAT_BUFSIZE, "%-8s", "FS");
+	for (b = 0; b < SPHW_AGE_BUCKETS - 1; b++)
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, " %8lu", 1UL << b);
+	len += scnprintf(buf + len, STAT_BUFSIZE - len, " %8s\n", "inf");
+
+	n = smp_load_acquire(&sphw_n_fs);
+	for (fs = 0; fs < n; fs++)
+	{
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, "%-8s", sphw_fs[fs]);
+		for (b = 0; b < SPHW_AGE_BUCKETS; b++)
+		{
+			unsigned long sum = 0;
+
+			for_each_possible_cpu(cpu)
+				sum += per_cpu(sphw_age_hist, cpu).cnt[fs][b];
+			len += scnprintf(buf + len, STAT_BUFSIZE - len, " %8lu", sum);
+		}
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, "\n");
+	}
+
+	ret = simple_read_from_buffer(user_buffer, count, ppos, buf, min(len, STAT_BUFSIZE));
+	kfree(buf);
+
+	return ret;
+}
+
+// customized write : clear the histogram
+static ssize_t age_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(sphw_age_hist, cpu), 0, sizeof(sphw_age));
+
+	return count;
+}
+
+static const struct file_operations age_fops = {
+	.owner = THIS_MODULE,
+	.read = age_read,
+	.write = age_write,
+};
+
+// customized read : bytes of each write class, one line per file system
+static ssize_t class_read(struct file *file, char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	char *buf;
+	ssize_t ret;
+	int len, n, fs, c, cpu;
+
+	buf = kmalloc(STAT_BUFSIZE, GFP_KERNEL);
+	if(buf == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	len = scnprintf(buf, STAT_BUFSIZE, "%-8s", "FS");
+	for (c = 0; c < SPHW_CLASSES; c++)
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, " %14s", class_name[c]);
+	len += scnprintf(buf + len, STAT_BUFSIZE - len, "\n");
+
+	n = smp_load_acquire(&sphw_n_fs);
+	for (fs = 0; fs < n; fs++)
+	{
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, "%-8s", sphw_fs[fs]);
+		for (c = 0; c < SPHW_CLASSES; c++)
+		{
+			unsigned long long sum = 0;
+
+			for_each_possible_cpu(cpu)
+				sum += per_cpu(sphw_class_hist, cpu).bytes[fs][c];
+			len += scnprintf(buf + len, STAT_BUFSIZE - len, " %14llu", sum);
+		}
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, "\n");
+	}
+
+	ret = simple_read_from_buffer(user_buffer, count, ppos, buf, min(len, STAT_BUFSIZE));
+	kfree(buf);
+
+	return ret;
+}
+
+// customized write : clear the counters
+static ssize_t class_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(sphw_class_hist, cpu), 0, sizeof(sphw_class_bytes));
+
+	return count;
+}
+
+static const struct file_operations class_fops = {
+	.owner = THIS_MODULE,
+	.read = class_read,
+	.write = class_write,
+};
+
+// customized read : write counters, one line per device, like /proc/diskstats
+//		"major:minor fs writes bytes flush fua discard", fs is "-" if the device has none
+static ssize_t stat_read(struct file *file, char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	char *buf;
+	ssize_t ret;
+	int len = 0, n, d, cpu;
+
+	buf = kmalloc(STAT_BUFSIZE, GFP_KERNEL);
+	if(buf == NULL)
+	{
+		return -ENOMEM;
+	}
+
+	n = smp_load_acquire(&sphw_n_dev);
+	for (d = 0; d < n; d++)
+	{
+		sphw_counts sum = { 0 };
+
+		for_each_possible_cpu(cpu)
+		{
+			const sphw_counts *c = &per_cpu(sphw_stat, cpu).dev[d];
+
+			sum.writes += c->writes;
+			sum.bytes += c->bytes;
+			sum.flush += c->flush;
+			sum.fua += c->fua;
+			sum.discard += c->discard;
+		}
+		len += scnprintf(buf + len, STAT_BUFSIZE - len, "%u:%u %s %llu %llu %llu %llu %llu\n",
+			MAJOR(sphw_dev[d].dev), MINOR(sphw_dev[d].dev),
+			sphw_dev[d].fs >= 0 ? sphw_fs[sphw_dev[d].fs] : "-",
+			sum.writes, sum.bytes, sum.flush, sum.fua, sum.discard);
+	}
+
+	ret = simple_read_from_buffer(user_buffer, count, ppos, buf, min(len, STAT_BUFSIZE));
+	kfree(buf);
+
+	return ret;
+}
+
+// customized write : clear the counters
+static ssize_t stat_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(sphw_stat, cpu), 0, sizeof(sphw_stats));
+
+	return count;
+}
+
+static const struct file_operations stat_fops = {
+	.owner = THIS_MODULE,
+	.read = stat_read,
+	.write = stat_write,
 };
 
 // initialize : make proc file
@@ -88,6 +433,10 @@ static int __init simple_init(void)
 
 	proc_dir = proc_mkdir(PROC_DIRNAME, NULL);
 	proc_file = proc_create(PROC_FILENAME, 0600, proc_dir, &myproc_fops);
+	ctl_file = proc_create(PROC_CTLNAME, 0600, proc_dir, &ctl_fops);
+	age_file = proc_create(PROC_AGENAME, 0600, proc_dir, &age_fops);
+	class_file = proc_create(PROC_CLASSNAME, 0600, proc_dir, &class_fops);
+	stat_file = proc_create(PROC_STATNAME, 0644, proc_dir, &stat_fops);
 
 	return 0;
 }
@@ -97,6 +446,10 @@ static void __exit simple_exit(void)
 {
 	printk(KERN_INFO "Simple Module Exit!!\n");
 
+	remove_proc_entry(PROC_STATNAME, proc_dir);
+	remove_proc_entry(PROC_CLASSNAME, proc_dir);
+	remove_proc_entry(PROC_AGENAME, proc_dir);
+	remove_proc_entry(PROC_CTLNAME, proc_dir);
 	remove_proc_entry(PROC_FILENAME, proc_dir);
 	remove_proc_entry(PROC_DIRNAME, NULL);
 
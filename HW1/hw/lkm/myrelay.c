@@ -0,0 +1,156 @@
+/*
+ * relay export of sphw records
+ *	registers as the export backend of the tracer in kernel (sphw_exporter)
+ *	and writes every record to a per-cpu relay channel in debugfs :
+ *		/sys/kernel/debug/sphw/trace0, trace1, ...	records (struct sphw_bin)
+ *		/sys/kernel/debug/sphw/dropped				records lost because the sub-buffers were full
+ *		/sys/kernel/debug/sphw/flush				write anything : make partial sub-buffers readable
+ *	userspace reads the channel with splice() (analyzer/relay_reader)
+ *
+ * parameters : subbuf_size, n_subbufs -> size of the channel per cpu
+ *              exclusive -> 1 : records go to the relay channel only, not to the circular queue
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/relay.h>
+#include <linux/debugfs.h>
+#include <linux/string.h>
+#include <linux/rcupdate.h>
+
+#include "sphw_capture.h"	// sphw, sphw_exporter
+#include "sphw_relay.h"
+
+static struct dentry *relay_dir;
+static struct dentry *dropped_file;
+static struct dentry *flush_file;
+static struct rchan *chan;
+
+static atomic_t dropped = ATOMIC_INIT(0);
+
+static unsigned int subbuf_size = 256 * 1024;
+module_param(subbuf_size, uint, 0444);
+MODULE_PARM_DESC(subbuf_size, "size of one sub-buffer (bytes)");
+
+static unsigned int n_subbufs = 16;
+module_param(n_subbufs, uint, 0444);
+MODULE_PARM_DESC(n_subbufs, "sub-buffers per cpu");
+
+static bool exclusive = true;
+module_param(exclusive, bool, 0644);
+MODULE_PARM_DESC(exclusive, "don't push records to the circular queue");
+
+// called from submit_bio() for every traced write
+static int relay_record(sphw *rec)
+{
+	struct sphw_bin bin;
+
+	bin.ns = rec->ns;
+	bin.time = rec->time;
+	bin.block_no = rec->block_no;
+	bin.rw = rec->rw;
+	bin.size = rec->size;
+	bin.dev = rec->dev;
+	bin.pid = rec->pid;
+	bin.cpu = rec->cpu;
+	bin.wclass = rec->wclass;
+	bin.pad = 0;
+	strncpy(bin.fs_name, rec->fs_name, SPHW_RELAY_FS_LEN);
+
+	// relay_write() disables irqs, it's safe from any context
+	relay_write(chan, &bin, sizeof(bin));
+
+	return exclusive;
+}
+
+static struct sphw_exporter relay_exporter = {
+	.record = relay_record,
+};
+
+// no-overwrite mode : when all sub-buffers are full, drop new records
+static int subbuf_start_handler(struct rchan_buf *buf, void *subbuf, void *prev_subbuf, size_t prev_padding)
+{
+	if (relay_buf_full(buf)) {
+		atomic_inc(&dropped);
+		return 0;
+	}
+
+	return 1;
+}
+
+static struct dentry *create_buf_file_handler(const char *filename, struct dentry *parent,
+	umode_t mode, struct rchan_buf *buf, int *is_global)
+{
+	return debugfs_create_file(filename, mode, parent, buf, &relay_file_operations);
+}
+
+static int remove_buf_file_handler(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+
+	return 0;
+}
+
+static struct rchan_callbacks relay_callbacks = {
+	.subbuf_start = subbuf_start_handler,
+	.create_buf_file = create_buf_file_handler,
+	.remove_buf_file = remove_buf_file_handler,
+};
+
+// customized write : flush partial sub-buffers to readers
+static ssize_t flush_write(struct file *file, const char __user *user_buffer, size_t count, loff_t *ppos)
+{
+	relay_flush(chan);
+
+	return count;
+}
+
+static const struct file_operations flush_fops = {
+	.owner = THIS_MODULE,
+	.write = flush_write,
+};
+
+// initialize : open relay channel, register as export backend
+static int __init relay_init(void)
+{
+	printk(KERN_INFO "Relay Module Init!!\n");
+
+	relay_dir = debugfs_create_dir(SPHW_RELAY_DIR, NULL);
+	if (!relay_dir)
+		return -ENOMEM;
+
+	chan = relay_open(SPHW_RELAY_BASE, relay_dir, subbuf_size, n_subbufs, &relay_callbacks, NULL);
+	if (!chan) {
+		debugfs_remove_recursive(relay_dir);
+		return -ENOMEM;
+	}
+
+	dropped_file = debugfs_create_atomic_t("dropped", 0400, relay_dir, &dropped);
+	flush_file = debugfs_create_file("flush", 0200, relay_dir, NULL, &flush_fops);
+
+	rcu_assign_pointer(sphw_exporter, &relay_exporter);
+
+	return 0;
+}
+
+// When dispatching this module, wait until no one uses the channel, then remove it
+static void __exit relay_exit(void)
+{
+	printk(KERN_INFO "Relay Module Exit!!\n");
+
+	RCU_INIT_POINTER(sphw_exporter, NULL);
+	synchronize_rcu();
+
+	relay_close(chan);
+	debugfs_remove_recursive(relay_dir);
+
+	return;
+}
+
+module_init(relay_init);
+module_exit(relay_exit);
+
+MODULE_DESCRIPTION("relay channel for sphw records");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("NEW");
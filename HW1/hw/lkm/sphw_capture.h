@@ -0,0 +1,439 @@
+/*
+ * sphw tracer : record layout and capture of write bios
+ *	the layout (macros, structs, exported symbols) is for every user of the tracer :
+ *	myproc.c, myrelay.c read what the capture writes.
+ *	the capture itself is compiled once, where the symbols live, with SPHW_CAPTURE defined :
+ *		blk-core.c (patched kernel) and sphw_kprobe.c (kprobe module)
+ *
+ *		#define SPHW_CAPTURE
+ *		#include "sphw_capture.h"
+ *
+ *	blk-core.c is built in block/ of the kernel tree, this header is copied next to it.
+ */
+
+#ifndef _SPHW_CAPTURE_H
+#define _SPHW_CAPTURE_H
+
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+
+#define q_MAX 1000
+#define SPHW_OFF 0				// tracer modes
+#define SPHW_ON 1
+#define SPHW_STATS 2			// counters only, no records
+#define SPHW_FS_LEN 16
+#define SPHW_FS_MAX 8			// file systems with statistics, see sphw_fs_slot()
+#define SPHW_DEV_MAX 16			// devices with counters, see sphw_dev_slot()
+#define SPHW_AGE_BUCKETS 20		// dirty age histogram : <1ms, [1,2)ms, [2,4)ms ... >=2^18ms
+#define SPHW_DATA 0				// write classes, see sphw_class()
+#define SPHW_NODE 1
+#define SPHW_META 2
+#define SPHW_GC 3
+#define SPHW_JOURNAL 4
+#define SPHW_CLASSES 5
+#define F2FS_NODE_INO_NUM 1		// inode numbers of f2fs node / meta mappings (mkfs.f2fs)
+#define F2FS_META_INO_NUM 2
+
+// struct for hw1
+//		entry of a circular queue
+typedef struct _sphw
+{
+	const char* fs_name;			// file system name : ext4 / f2fs
+	long time;						// write time
+	unsigned long long block_no;	// block number
+	unsigned int size;				// bio size (bytes)
+	unsigned long rw;				// bio flags : REQ_WRITE, REQ_SYNC, REQ_META, REQ_FLUSH ...
+	unsigned long long ns;			// write time, monotonic (ns)
+	unsigned int dev;				// device (dev_t)
+	int pid;						// submitting process
+	int cpu;						// submitting cpu
+	int wclass;						// write class : SPHW_DATA, SPHW_NODE ...
+}sphw;
+
+// export backend, see sphw_export()
+//		record() returns non-zero if the record should not go to the queue
+struct sphw_exporter
+{
+	int (*record)(sphw *rec);
+};
+
+// devices seen by the tracer, with the file system on them (slot of sphw_fs, -1 : none)
+//		a device gets a new slot when it is mounted with another file system
+typedef struct _sphw_target
+{
+	unsigned int dev;
+	int fs;
+}sphw_target;
+
+// write counters of one device, summed over cpus on read
+typedef struct _sphw_counts
+{
+	unsigned long long writes;		// bios with data
+	unsigned long long bytes;
+	unsigned long long flush;		// REQ_FLUSH, with or without data
+	unsigned long long fua;
+	unsigned long long discard;
+}sphw_counts;
+
+typedef struct _sphw_stats
+{
+	sphw_counts dev[SPHW_DEV_MAX];
+}sphw_stats;
+
+// how long the data of write bios stayed dirty in the page cache, per file system
+//		cnt[slot][b] : b = 0 -> <1ms, b -> [2^(b-1), 2^b) ms
+typedef struct _sphw_age
+{
+	unsigned long cnt[SPHW_FS_MAX][SPHW_AGE_BUCKETS];
+}sphw_age;
+
+// bytes written in each write class, per file system
+typedef struct _sphw_class_bytes
+{
+	unsigned long long bytes[SPHW_FS_MAX][SPHW_CLASSES];
+}sphw_class_bytes;
+
+extern sphw c_q[q_MAX];				// the circular queue
+extern int q_front;					// front of the circular queue
+extern atomic64_t q_seq;			// number of records ever pushed
+extern unsigned long long c_q_seq[q_MAX];	// sequence number + 1 of each slot, 0 while written
+extern void push_cq(sphw new_sphw);	// insert sphw at the front of the circular queue
+
+extern int sphw_mode;				// SPHW_OFF / SPHW_STATS / SPHW_ON
+extern unsigned int sphw_sample;	// record 1 out of sphw_sample writes
+extern char sphw_filter[SPHW_FS_LEN];	// record only this file system, "" : all
+extern char sphw_fs[SPHW_FS_MAX][SPHW_FS_LEN];	// file systems seen by the tracer
+extern int sphw_n_fs;
+extern sphw_target sphw_dev[SPHW_DEV_MAX];	// devices seen by the tracer
+extern int sphw_n_dev;
+
+DECLARE_PER_CPU(sphw_stats, sphw_stat);
+DECLARE_PER_CPU(sphw_age, sphw_age_hist);
+DECLARE_PER_CPU(sphw_class_bytes, sphw_class_hist);
+
+extern struct sphw_exporter __rcu *sphw_exporter;
+
+#ifdef SPHW_CAPTURE
+
+sphw c_q[q_MAX];
+EXPORT_SYMBOL(c_q);					// for proc file
+
+int q_front = 0;
+EXPORT_SYMBOL(q_front);				// for proc file
+
+atomic64_t q_seq = ATOMIC64_INIT(0);
+EXPORT_SYMBOL(q_seq);				// for proc file
+
+// readers compare c_q_seq of a slot before and after copying it to detect overwrites
+unsigned long long c_q_seq[q_MAX];
+EXPORT_SYMBOL(c_q_seq);				// for proc file
+
+// function for the circular queue
+//		writers on different cpus take different slots, no lock
+void push_cq(sphw new_sphw)
+{
+	unsigned long long seq = atomic64_inc_return(&q_seq) - 1;
+	int slot = seq % q_MAX;
+
+	WRITE_ONCE(c_q_seq[slot], 0);
+	smp_wmb();
+	c_q[slot] = new_sphw;
+	smp_wmb();
+	WRITE_ONCE(c_q_seq[slot], seq + 1);
+
+	q_front = (slot+1)%q_MAX;	// circular
+	return;
+}
+EXPORT_SYMBOL(push_cq);				// for proc file
+
+// tracer mode, changed through /proc/myproc/ctl
+//		SPHW_OFF : nothing, SPHW_STATS : counters only, SPHW_ON : counters and records
+int sphw_mode = SPHW_ON;
+EXPORT_SYMBOL(sphw_mode);
+
+unsigned int sphw_sample = 1;
+EXPORT_SYMBOL(sphw_sample);
+
+char sphw_filter[SPHW_FS_LEN];
+EXPORT_SYMBOL(sphw_filter);
+
+static DEFINE_PER_CPU(unsigned int, sphw_seen);	// writes seen on this cpu, for sampling
+
+// the slot of a file system indexes its statistics
+//		names are copied : file system modules may go away. slots are never freed.
+char sphw_fs[SPHW_FS_MAX][SPHW_FS_LEN];
+EXPORT_SYMBOL(sphw_fs);
+
+int sphw_n_fs;						// used slots of sphw_fs
+EXPORT_SYMBOL(sphw_n_fs);
+
+// for claiming a slot of sphw_fs or sphw_dev, only the first write of a file system / device takes it
+//		irqsave : submit_bio() is also called from softirq and completion context (stacked, dm resubmit)
+static DEFINE_SPINLOCK(sphw_slot_lock);
+
+// slot of fs_name, takes a new slot the first time a file system is seen
+//		returns -1 if the table is full
+static int sphw_fs_slot(const char *fs_name)
+{
+	unsigned long irq;
+	int i, n = smp_load_acquire(&sphw_n_fs);
+
+	for (i = 0; i < n; i++)
+		if (!strcmp(sphw_fs[i], fs_name))
+			return i;
+	if (n == SPHW_FS_MAX)
+		return -1;			// full : no lock on every write of the file systems left out
+
+	spin_lock_irqsave(&sphw_slot_lock, irq);
+	for (i = 0; i < sphw_n_fs; i++)
+		if (!strcmp(sphw_fs[i], fs_name))
+			break;
+	if (i == sphw_n_fs && i < SPHW_FS_MAX) {
+		strlcpy(sphw_fs[i], fs_name, SPHW_FS_LEN);
+		smp_store_release(&sphw_n_fs, i + 1);
+	}
+	spin_unlock_irqrestore(&sphw_slot_lock, irq);
+
+	return i < SPHW_FS_MAX ? i : -1;
+}
+
+sphw_target sphw_dev[SPHW_DEV_MAX];
+EXPORT_SYMBOL(sphw_dev);
+
+int sphw_n_dev;						// used slots of sphw_dev
+EXPORT_SYMBOL(sphw_n_dev);
+
+// slot of (dev, fs), -1 if the table is full
+static int sphw_dev_slot(unsigned int dev, int fs)
+{
+	unsigned long irq;
+	int i, n = smp_load_acquire(&sphw_n_dev);
+
+	for (i = 0; i < n; i++)
+		if (sphw_dev[i].dev == dev && sphw_dev[i].fs == fs)
+			return i;
+	if (n == SPHW_DEV_MAX)
+		return -1;
+
+	spin_lock_irqsave(&sphw_slot_lock, irq);
+	for (i = 0; i < sphw_n_dev; i++)
+		if (sphw_dev[i].dev == dev && sphw_dev[i].fs == fs)
+			break;
+	if (i == sphw_n_dev && i < SPHW_DEV_MAX) {
+		sphw_dev[i].dev = dev;
+		sphw_dev[i].fs = fs;
+		smp_store_release(&sphw_n_dev, i + 1);
+	}
+	spin_unlock_irqrestore(&sphw_slot_lock, irq);
+
+	return i < SPHW_DEV_MAX ? i : -1;
+}
+
+DEFINE_PER_CPU(sphw_stats, sphw_stat);
+EXPORT_PER_CPU_SYMBOL(sphw_stat);
+
+// count a write bio, this is all the tracer does in SPHW_STATS mode
+//		rw : flags of the bio and of the submit_bio() call
+static void sphw_count(struct bio *bio, unsigned long rw, int fs)
+{
+	int slot = sphw_dev_slot(bio->bi_bdev->bd_dev, fs);
+
+	if (slot < 0)
+		return;
+
+	if (bio_has_data(bio)) {
+		this_cpu_inc(sphw_stat.dev[slot].writes);
+		this_cpu_add(sphw_stat.dev[slot].bytes, bio->bi_iter.bi_size);
+	}
+	if (rw & REQ_FLUSH)
+		this_cpu_inc(sphw_stat.dev[slot].flush);
+	if (rw & REQ_FUA)
+		this_cpu_inc(sphw_stat.dev[slot].fua);
+	if (rw & REQ_DISCARD)
+		this_cpu_inc(sphw_stat.dev[slot].discard);
+}
+
+DEFINE_PER_CPU(sphw_age, sphw_age_hist);
+EXPORT_PER_CPU_SYMBOL(sphw_age_hist);
+
+DEFINE_PER_CPU(sphw_class_bytes, sphw_class_hist);
+EXPORT_PER_CPU_SYMBOL(sphw_class_hist);
+
+// owner of the first page of a bio, NULL for anonymous pages and bios without data
+static struct inode *sphw_page_inode(struct bio *bio)
+{
+	struct address_space *mapping;
+
+	if (!bio_has_data(bio))
+		return NULL;
+
+	mapping = page_mapping(bio_page(bio));
+	return mapping ? mapping->host : NULL;
+}
+
+// write class of a bio
+//		the writing task : f2fs GC thread (f2fs_gc-*), jbd2 thread (jbd2/*)
+//		the owner of its pages : f2fs node inode, f2fs meta inode (checkpoint, SIT, NAT, SSA areas),
+//		                         block device inode (buffer head metadata : bitmaps, inode tables ...)
+//		the flags : REQ_META
+static int sphw_class(struct bio *bio, unsigned long rw, const char *fs_name)
+{
+	struct inode *inode;
+
+	if (!strncmp(current->comm, "f2fs_gc", 7))
+		return SPHW_GC;
+	if (!strncmp(current->comm, "jbd2/", 5))
+		return SPHW_JOURNAL;
+
+	inode = sphw_page_inode(bio);
+	if (inode != NULL)
+	{
+		if (S_ISBLK(inode->i_mode))
+			return SPHW_META;
+		if (inode->i_sb == bio->bi_bdev->bd_super && !strcmp(fs_name, "f2fs"))
+		{
+			if (inode->i_ino == F2FS_NODE_INO_NUM)
+				return SPHW_NODE;
+			if (inode->i_ino == F2FS_META_INO_NUM)
+				return SPHW_META;
+		}
+	}
+
+	if (rw & REQ_META)
+		return SPHW_META;
+
+	return SPHW_DATA;
+}
+
+// dirty age of a page cache write : now - dirtied_when of the inode of its first page
+//		bios of O_DIRECT, swap or block device metadata have no inode of this file system
+static void sphw_dirty_age(struct bio *bio, int slot)
+{
+	struct inode *inode;
+	unsigned long dirtied, age_ms;
+	int b;
+
+	if (slot < 0)
+		return;
+
+	inode = sphw_page_inode(bio);
+	if (inode == NULL || inode->i_sb != bio->bi_bdev->bd_super)
+		return;
+
+	dirtied = READ_ONCE(inode->dirtied_when);
+	if (dirtied == 0 || time_after(dirtied, jiffies))
+		return;
+
+	age_ms = jiffies_to_msecs(jiffies - dirtied);
+	b = min_t(int, fls_long(age_ms), SPHW_AGE_BUCKETS - 1);
+	this_cpu_inc(sphw_age_hist.cnt[slot][b]);
+}
+
+// export backend : a module (myrelay.ko) may take records instead of the circular queue
+struct sphw_exporter __rcu *sphw_exporter;
+EXPORT_SYMBOL(sphw_exporter);
+
+static int sphw_export(sphw *rec)
+{
+	struct sphw_exporter *ex;
+	int consumed = 0;
+
+	rcu_read_lock();
+	ex = rcu_dereference(sphw_exporter);
+	if (ex)
+		consumed = ex->record(rec);
+	rcu_read_unlock();
+
+	return consumed;
+}
+
+// record a write bio
+//		rw : the rw argument of submit_bio(), not yet in bio->bi_rw when called from a kprobe
+static void sphw_capture(struct bio *bio, int rw)
+{
+	sphw new_sphw;
+	struct timespec now_t;
+	unsigned long flags;
+	int slot;
+
+	if (sphw_mode == SPHW_OFF)
+		return;
+
+	if(bio == NULL)
+	{
+		printk(KERN_WARNING "No Bio!!\n");
+		return;
+	}
+
+	// flags as submit_bio() sets them
+	flags = bio->bi_rw | rw;
+
+	// get file system name
+	//		warning : super block could be NULL
+	if(bio->bi_bdev->bd_super != NULL)
+	{
+		new_sphw.fs_name = bio->bi_bdev->bd_super->s_type->name;
+		slot = sphw_fs_slot(new_sphw.fs_name);
+	} else {
+		new_sphw.fs_name = "";
+		slot = -1;
+	}
+
+	// counters : every write, also flushes and discards without data
+	sphw_count(bio, flags, slot);
+	if (sphw_mode == SPHW_STATS || !bio_has_data(bio))
+		return;
+
+	// sampling : skip sphw_sample-1 out of sphw_sample writes on this cpu
+	if (sphw_sample > 1 && this_cpu_inc_return(sphw_seen) % sphw_sample)
+		return;
+
+	if (bio->bi_bdev->bd_super == NULL)
+		printk(KERN_WARNING "No File System Name!!\n");
+
+	// filtering : only the file system in sphw_filter
+	if (sphw_filter[0] && strcmp(new_sphw.fs_name, sphw_filter))
+		return;
+
+	// statistics of this file system : dirty age, bytes per write class
+	//		writes without a file system have none
+	sphw_dirty_age(bio, slot);
+	new_sphw.wclass = sphw_class(bio, flags, new_sphw.fs_name);
+	if (slot >= 0)
+		this_cpu_add(sphw_class_hist.bytes[slot][new_sphw.wclass], bio->bi_iter.bi_size);
+
+	// get write time
+	getnstimeofday(&now_t);
+	new_sphw.time = now_t.tv_sec;
+	new_sphw.ns = ktime_get_ns();
+
+	// get block number
+	new_sphw.block_no = bio->bi_iter.bi_sector;
+
+	// get size and flags of the bio
+	new_sphw.size = bio->bi_iter.bi_size;
+	new_sphw.rw = flags;
+
+	// get device, process and cpu, as blktrace does
+	new_sphw.dev = bio->bi_bdev->bd_dev;
+	new_sphw.pid = current->pid;
+	new_sphw.cpu = raw_smp_processor_id();
+
+	// hand it to the export backend, or push information into circular queue
+	if (!sphw_export(&new_sphw))
+		push_cq(new_sphw);
+}
+
+#endif	// SPHW_CAPTURE
+
+#endif
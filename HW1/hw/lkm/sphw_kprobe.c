@@ -0,0 +1,84 @@
+/*
+ * sphw tracer as a loadable module, for kernels without the blk-core.c patch
+ *	the capture shared with blk-core.c (sphw_capture.h), attached to submit_bio() with a kprobe.
+ *	it exports the same symbols as the patched kernel, so myproc.ko and myrelay.ko
+ *	load on top of it unchanged and give the same proc interface :
+ *		insmod sphw_kprobe.ko && insmod myproc.ko
+ *	a tracer update is a module reload, not a kernel rebuild.
+ *	on the patched kernel the symbols already exist and this module refuses to load.
+ *
+ * x86_64 and arm64 : submit_bio(int rw, struct bio *bio) of linux 4.4
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/kprobes.h>
+
+// the capture of blk-core.c
+#define SPHW_CAPTURE
+#include "sphw_capture.h"
+
+// arguments of submit_bio(int rw, struct bio *bio) at its first instruction
+#if defined(CONFIG_X86_64)
+#define ARG_RW(regs) ((int)(regs)->di)
+#define ARG_BIO(regs) ((struct bio *)(regs)->si)
+#elif defined(CONFIG_ARM64)
+#define ARG_RW(regs) ((int)(regs)->regs[0])
+#define ARG_BIO(regs) ((struct bio *)(regs)->regs[1])
+#else
+#error "sphw_kprobe : unsupported architecture"
+#endif
+
+// runs before submit_bio()
+//		the bio belongs to the caller and is left as it is,
+//		sphw_capture() adds rw to the flags the way submit_bio() will
+static int submit_bio_pre(struct kprobe *p, struct pt_regs *regs)
+{
+	int rw = ARG_RW(regs);
+	struct bio *bio = ARG_BIO(regs);
+
+	if (bio == NULL || !(rw & WRITE))
+		return 0;
+
+	sphw_capture(bio, rw);
+
+	return 0;
+}
+
+static struct kprobe submit_bio_probe = {
+	.symbol_name = "submit_bio",
+	.pre_handler = submit_bio_pre,
+};
+
+// initialize : attach to submit_bio()
+static int __init sphw_kprobe_init(void)
+{
+	int ret;
+
+	printk(KERN_INFO "Kprobe Module Init!!\n");
+
+	ret = register_kprobe(&submit_bio_probe);
+	if (ret < 0)
+		printk(KERN_WARNING "Kprobe Module : register_kprobe failed (%d)\n", ret);
+
+	return ret;
+}
+
+// When dispatching this module, detach from submit_bio()
+//		myproc.ko and myrelay.ko use its symbols, they are removed first
+static void __exit sphw_kprobe_exit(void)
+{
+	printk(KERN_INFO "Kprobe Module Exit!!\n");
+
+	unregister_kprobe(&submit_bio_probe);
+
+	return;
+}
+
+module_init(sphw_kprobe_init);
+module_exit(sphw_kprobe_exit);
+
+MODULE_DESCRIPTION("sphw tracer on a kprobe of submit_bio");
+MODULE_LICENSE("GPL");
+MODULE_VERSION("NEW");
@@ -0,0 +1,30 @@
+/*
+ * binary sphw record written to the relay channel of myrelay.ko
+ *	shared with the userspace reader (analyzer/relay_reader.c)
+ */
+
+#ifndef _SPHW_RELAY_H
+#define _SPHW_RELAY_H
+
+#include <linux/types.h>
+
+#define SPHW_RELAY_DIR "sphw"			// debugfs directory
+#define SPHW_RELAY_BASE "trace"			// per cpu files : trace0, trace1, ...
+#define SPHW_RELAY_FS_LEN 8
+
+struct sphw_bin
+{
+	__u64 ns;						// write time, monotonic (ns)
+	__s64 time;						// write time (s)
+	__u64 block_no;					// block number
+	__u64 rw;						// bio flags
+	__u32 size;						// bio size (bytes)
+	__u32 dev;						// device, major << 20 | minor
+	__u32 pid;						// submitting process
+	__u32 cpu;						// submitting cpu
+	__u32 wclass;					// write class : 0 data, 1 node, 2 meta, 3 gc, 4 journal
+	__u32 pad;
+	char fs_name[SPHW_RELAY_FS_LEN];	// file system name, '\0' padded
+};
+
+#endif
@@ -2,75 +2,160 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <sys/timeb.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <linux/io_uring.h>
 
 #include <pthread.h>
 
-#define MAX_PORT 9		    // maximum number of ports
-#define MAX_CONNECTION 5	// maximum number of connections per ports
+#include "log_format.h"
+
+#define MAX_CONNECTION 5	// default maximum number of connections per ports (-c)
+#define PORT_TABLE 64		// initial slots of the port table, power of 2
+#define THREAD_STACK (256 * 1024)	// stack of a receiving thread, holds its msg buffer
 #define MAX_MSG 65536		// maximum size of message
+#define ATSIGN_END 5		// '@' that end a session
+#define MAX_WORKER 64		// maximum number of epoll / io_uring threads
+#define MAX_EVENTS 64		// events taken per epoll_wait()
+#define CONNECT_TIMEOUT 3000	// default ms allowed to connect (-t)
+#define MAX_BURST 16		// messages received from a connection before it yields
+#define IDLE_WAIT 1			// ms an idle epoll thread blocks before trying to steal again
+#define URING_ENTRIES 256	// submission queue size of an io_uring
+#define URING_BUFS 64		// provided buffers per io_uring, power of 2
+#define URING_BGID 0		// provided buffer group id
+// log ring of a connection : starts at LOG_RING_MIN bytes and doubles up to LOG_RING_MAX
+//	when the logger falls behind or a message does not fit. both powers of 2, LOG_RING_MAX above MAX_MSG.
+//	a ring that wrapped is resident : LOG_RING_MIN per quiet connection (20k : 320 MB),
+//	LOG_RING_MAX per connection that ever got that far ahead of the logger (20k : 5 GB)
+#define LOG_RING_MIN (16 * 1024)
+#define LOG_RING_MAX (256 * 1024)
+#define LOG_BATCH 256		// records per writev()
+#define LOG_IDLE 1000		// us the logger sleeps when every queue is empty
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024		// linux limit of writev(), limits.h defines it for _GNU_SOURCE only
+#endif
+
+// receive modes
+#define MODE_THREAD 0		// one thread per socket, blocking recv()
+#define MODE_EPOLL 1		// a pool of threads multiplexing all sockets with epoll, work stealing
+#define MODE_URING 2		// a few threads with an io_uring each, multishot recv
+
+// log formats
+#define LOG_BIN 0			// full messages, log_format.h
+#define LOG_TEXT 1			// "time | msg size | msg" lines
 
 
 // initialize ports
-// 	returns the number of available ports
-int init_ports(int *ports) {
+// 	returns the number of available ports, *ports is grown to hold them
+//	exits at the end of input
+int init_ports(int **ports) {
 
 	// input : the number of ports client use
 	int port_num;
-	scanf("%d",&port_num);
+	if (scanf("%d",&port_num) != 1 || port_num < 0)
+		exit(0);
+
+	*ports = (int *)realloc(*ports, (port_num + 1) * sizeof(int));
+	if (!*ports){
+		perror("Client : realloc");
+		exit(0);
+	}
 
 	// input : user defines the port numbers
 	for(int i = 0; i < port_num; i++){
 		int p;
-		scanf("%d",&p);
-		ports[i] = p;
+		if (scanf("%d",&p) != 1)
+			exit(0);
+		(*ports)[i] = p;
 	}
 
 	return port_num;
 }
 
+// port -> connection number, hash table with linear probing
+typedef struct _port_table {
+	int *port;		// 0 : empty slot
+	int *count;
+	int size;		// slots, power of 2
+	int n;			// ports in the table
+}port_table;
+
+void port_table_init(port_table *t, int size) {
+	t->port = (int *)calloc(size, sizeof(int));
+	t->count = (int *)calloc(size, sizeof(int));
+	t->size = size;
+	t->n = 0;
+
+	if (!t->port || !t->count){
+		perror("Client : calloc");
+		exit(0);
+	}
 
-// create socket
-//	args : 	idx_port_mapping -> to check connection number per ports
-//		client_socket -> socket fd
-//		port -> socket location,
-//		socket_connection_num -> connection number per ports
-void create_socket(int* idx_port_mapping, int *client_socket, int port, int* socket_connection_num) {
-	int loc = -1;					    // index of port in idx_port_mapping
-	int last_idx = MAX_PORT-1;			// last valid information in idx_port_mapping
-
-	// table lookup for idx-port mapping to manage connection number per ports
-	for(int i = 0 ; i < MAX_PORT ; i++){
-		if(idx_port_mapping[i]==port){
-			loc = i;
-			break;
-		}
-		if(idx_port_mapping[i]==0){
-			last_idx = i;
-			break;
+	return;
+}
+
+void port_table_free(port_table *t) {
+	free(t->port);
+	free(t->count);
+
+	return;
+}
+
+// connection number of a port, added with 0 if the port never appeared before
+int *port_count(port_table *t, int port) {
+	unsigned int i;
+
+	// keep the table at most half full
+	if (2 * (t->n + 1) > t->size){
+		port_table old = *t;
+
+		port_table_init(t, old.size * 2);
+		for (int j = 0; j < old.size; j++){
+			if (old.port[j])
+				*port_count(t, old.port[j]) = old.count[j];
 		}
+		port_table_free(&old);
 	}
 
-	// check if there is available connection, which means ports keeps less than 5 connections.
-	if(loc==-1){
-		// if the port number never appeared before,
-		//	update mapping information and increase connection number.
-		idx_port_mapping[last_idx] = port;
-		socket_connection_num[last_idx] +=1;
+	for (i = (unsigned int)port * 2654435761u & (t->size - 1); t->port[i]; i = (i + 1) & (t->size - 1)){
+		if (t->port[i] == port)
+			return &t->count[i];
 	}
-	else{
-		if(socket_connection_num[loc] >= MAX_CONNECTION){
-			printf("\nClient : Port %d has no available connection\n", port);
-			exit(0);
-		}
-		// increase connection number of the port
-		socket_connection_num[loc] +=1;
+
+	t->port[i] = port;
+	t->n++;
+
+	return &t->count[i];
+}
+
+// create socket
+//	args : 	port_table -> to check connection number per ports
+//		client_socket -> socket fd
+//		port -> socket location,
+//		max_connection -> connections allowed per ports
+void create_socket(port_table *t, int *client_socket, int port, int max_connection) {
+	int *count = port_count(t, port);	// connection number of the port
+
+	// check if there is available connection, which means ports keeps less than max_connection connections.
+	if(*count >= max_connection){
+		printf("\nClient : Port %d has no available connection\n", port);
+		exit(0);
 	}
+	// increase connection number of the port
+	*count += 1;
 
 	// create an endpoint for communication
 	//	args : PF_INET -> IPv4, SOCK_STREAM -> TCP 
@@ -99,122 +184,515 @@ void configure_server(struct sockaddr_in *server_addr, char *server_IP, int port
 	return;
 }
 
-// connect socket to server
-void connect_server(struct sockaddr_in *server_addr, int client_socket, int port) {
+// every connection holds a socket and a log file : raise the fd limit as far as allowed
+void raise_nofile(void) {
+	struct rlimit rl;
 
-	if (connect(client_socket, (struct sockaddr *)server_addr, sizeof(*server_addr)) < 0){
-		printf("\nConnection failed, port %d\n", port);
-		exit(0);
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max){
+		rl.rlim_cur = rl.rlim_max;
+		if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+			perror("Client : setrlimit");
 	}
 
 	return;
 }
 
+// ms since start
+long elapsed_ms(struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// connect all sockets to the server at once
+//	connect() is non-blocking, the results are collected with epoll : one round trip for all sockets.
+//	a socket not connected within timeout ms fails.
+//	failed sockets are reported, closed and removed from client_socket and ports,
+//	connected ones are back to blocking mode.
+//	returns the number of connected sockets
+int connect_all(char *server_IP, int *client_socket, int *ports, int port_num, int timeout) {
+	struct sockaddr_in server_addr;
+	struct epoll_event events[MAX_EVENTS];
+	struct timespec start;
+	int *result = (int *)malloc((port_num + 1) * sizeof(int));	// -1 : in progress, 0 : connected, errno
+	int epfd = epoll_create1(0);
+	int pending = 0, connected = 0;
+
+	if (!result || epfd < 0){
+		perror("Client : connect");
+		exit(0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < port_num; i++){
+		fcntl(client_socket[i], F_SETFL, fcntl(client_socket[i], F_GETFL) | O_NONBLOCK);
+
+		// initialize server information for connection
+		configure_server(&server_addr, server_IP, ports[i]);
+
+		result[i] = 0;
+		if (connect(client_socket[i], (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0){
+			struct epoll_event ev;
+
+			result[i] = errno;
+			if (errno != EINPROGRESS)
+				continue;
+
+			// writable once connected or failed
+			ev.events = EPOLLOUT;
+			ev.data.u32 = i;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, client_socket[i], &ev) < 0){
+				result[i] = errno;
+				continue;
+			}
+			result[i] = -1;
+			pending++;
+		}
+	}
+
+	while (pending > 0){
+		long left = timeout - elapsed_ms(&start);
+		int n;
+
+		if (left <= 0)
+			break;
+
+		n = epoll_wait(epfd, events, MAX_EVENTS, left);
+		if (n < 0 && errno != EINTR){
+			perror("Client : epoll_wait");
+			exit(0);
+		}
+
+		for (int j = 0; j < n; j++){
+			int i = events[j].data.u32;
+			int err = 0;
+			socklen_t len = sizeof(err);
+
+			getsockopt(client_socket[i], SOL_SOCKET, SO_ERROR, &err, &len);
+			result[i] = err;
+			epoll_ctl(epfd, EPOLL_CTL_DEL, client_socket[i], NULL);
+			pending--;
+		}
+	}
+	close(epfd);
+
+	// keep the connected sockets
+	for (int i = 0; i < port_num; i++){
+		if (result[i] == -1)
+			result[i] = ETIMEDOUT;
+
+		if (result[i] != 0){
+			printf("\nConnection failed, port %d : %s\n", ports[i], strerror(result[i]));
+			close(client_socket[i]);
+			continue;
+		}
+
+		fcntl(client_socket[i], F_SETFL, fcntl(client_socket[i], F_GETFL) & ~O_NONBLOCK);
+		client_socket[connected] = client_socket[i];
+		ports[connected] = ports[i];
+		connected++;
+	}
+
+	free(result);
+
+	return connected;
+}
+
 // for log
-char *get_current_time() {
+//	wall clock - monotonic clock, taken once at startup
+static int64_t clock_offset;
 
-    struct timeb itb;
-    struct tm *lt;
-    static char s[20];
+// anchor the monotonic clock to the wall clock
+void init_clock(void) {
+	struct timespec rt, mt;
 
-    ftime(&itb);
+	clock_gettime(CLOCK_REALTIME, &rt);
+	clock_gettime(CLOCK_MONOTONIC, &mt);
 
-    lt = localtime(&itb.time);
+	clock_offset = ((int64_t)rt.tv_sec - mt.tv_sec) * 1000000000 + (rt.tv_nsec - mt.tv_nsec);
 
-    sprintf(s, "%02d:%02d:%02d.%03d", lt->tm_hour, lt->tm_min, lt->tm_sec, itb.millitm);
+	return;
+}
 
-    return s;
+// receive time, us since the epoch
+//	CLOCK_MONOTONIC through the vDSO, no syscall and no shared state : safe in every receiving thread.
+//	times of a session never go back, even if the wall clock is stepped meanwhile.
+//	formatting is left to the logger (format_log_time())
+uint64_t get_current_time(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + clock_offset) / 1000;
 }
 
+// queue of log records (log_rec and msg) of a connection, single producer single consumer
+//	producer : the thread receiving on the connection (one at a time)
+//	consumer : the logger thread, the only one writing the log file
+typedef struct _log_ring {
+	char *buf;				// size bytes, replaced only while the ring is empty
+	unsigned long size;		// power of 2
+	unsigned long head;		// consumed by the logger
+	unsigned long tail;		// produced by the receiving thread
+	int closed;				// no more records, the logger closes fd once drained
+	int fd;					// log file
+}log_ring;
+
+// a connection
+typedef struct _connection {
+	int fd;
+	int port;
+	log_ring log;
+	int done;		// finished, completions still in flight are dropped
+	int epfd;		// epoll instance the socket is registered on
+	int atsign;		// '@' received so far
+}connection;
+
 // a trigger function for finishing connection between server and client
-//	if '@' appears more than 5 times, connection terminated.
-int atsign_counting(const char * const buf, size_t len){
-	int i;
-	int n = 0;
-	for (i = 0; i < len; i++) {
-		if (buf[i] == '@')
-			n++;
+//	if '@' appears ATSIGN_END times in the session, connection terminated.
+//	the count is kept in the connection, so terminators split over several recv() are
+//	all counted. '@' are found with memchr(), vectorized by libc.
+//	returns 1 when the connection is finished
+int atsign_counting(connection *c, const char *buf, size_t len) {
+	const char *p = buf;
+	const char *end = buf + len;
+
+	while (c->atsign < ATSIGN_END && (p = memchr(p, '@', end - p)) != NULL){
+		c->atsign++;
+		p++;
 	}
-	return n;
-} 
 
-// a struct for implementing function, pthread_create() : args in args
-typedef struct _pthread_args {
-	int *client_socket;
-	int port;
-}p_thread_args;
+	return c->atsign >= ATSIGN_END;
+}
 
-// Clients receive server's msg
-void *server_msg(void *pThreadArgs) {
+// logger thread : writes the log files of every connection of a session
+typedef struct _log_writer {
+	pthread_t thread;
+	connection *conns;
+	int n;
+	time_cache tc;		// text logs : time formatting
+}log_writer;
 
-	int msg_len;         		// message size
-	char msg_buffer[MAX_MSG]; 	// message buffer
+static log_writer logger;
+static int log_format = LOG_BIN;
+
+// copy in / out of a log ring, wrapping at its end
+void ring_copy_in(log_ring *r, unsigned long pos, const void *src, size_t len) {
+	size_t off = pos & (r->size - 1);
+	size_t first = len < r->size - off ? len : r->size - off;
 
-	int client_socket_fd = *(((p_thread_args *)pThreadArgs)->client_socket);
-	int port_num = ((p_thread_args *)pThreadArgs)->port;
+	memcpy(r->buf + off, src, first);
+	memcpy(r->buf, (const char *)src + first, len - first);
 
-	// initialize log file
-	FILE *fp;
-	char log_path[20];
+	return;
+}
+
+void ring_copy_out(log_ring *r, unsigned long pos, void *dst, size_t len) {
+	size_t off = pos & (r->size - 1);
+	size_t first = len < r->size - off ? len : r->size - off;
+
+	memcpy(dst, r->buf + off, first);
+	memcpy((char *)dst + first, r->buf, len - first);
+
+	return;
+}
+
+// open log file of a connection
+void open_log(connection *c) {
+	log_ring *r = &c->log;
+	char log_path[32];
 
 	// set log path
-	sprintf(log_path, "./log/%d_%d.txt", port_num,client_socket_fd);
+	sprintf(log_path, "./log/%d_%d.%s", c->port, c->fd, log_format == LOG_BIN ? "bin" : "txt");
 
 	// open log file
-	fp = fopen(log_path, "w");
+	r->fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	r->buf = (char *)malloc(LOG_RING_MIN);
+	r->size = LOG_RING_MIN;
 
-	if (!fp){
+	if (r->fd < 0 || !r->buf ||
+	    (log_format == LOG_BIN && write(r->fd, LOG_MAGIC, LOG_MAGIC_LEN) != LOG_MAGIC_LEN)){
 		printf("Client : File open failed\n");
 		exit(0);
 	}
 
-	while(1){
-		int atsign_count = 0;	// trigger variable for terminating connection
-		char log_temp[80];	// buffer for writing msg to log, different from msg buffer
+	r->head = r->tail = 0;
+	r->closed = 0;
 
-		memset(log_temp,0,sizeof(log_temp));
-		memset(msg_buffer,0,sizeof(msg_buffer));
+	return;
+}
 
+// double the log ring until need bytes fit, the ring must be empty
+//	the logger has no pointer into an empty ring : its last drain stored head after writing.
+//	the new buffer is published to it with the next tail
+void grow_log(log_ring *r, unsigned long need) {
+	unsigned long size = r->size;
+
+	do
+		size *= 2;
+	while (size < need && size < LOG_RING_MAX);
+
+	free(r->buf);
+	r->buf = (char *)malloc(size);
+	if (!r->buf){
+		perror("Client : log ring");
+		exit(0);
+	}
+	r->size = size;
+
+	return;
+}
+
+// write log
+//	queue current time, msg size, msg for the logger thread
+//	a full ring grows once the logger has emptied it, at LOG_RING_MAX the thread waits for space
+void write_log(connection *c, const char *msg_buffer, int msg_len) {
+	log_ring *r = &c->log;
+	log_rec rec;
+	unsigned long tail = r->tail;
+	unsigned long need = sizeof(rec) + msg_len;
+
+	rec.time = get_current_time();
+	rec.conn = c->fd;
+	rec.len = msg_len;
+
+	while (r->size - (tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) < need){
+		if (r->size < LOG_RING_MAX && __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+			grow_log(r, need);
+		else
+			sched_yield();
+	}
+
+	ring_copy_in(r, tail, &rec, sizeof(rec));
+	ring_copy_in(r, tail + sizeof(rec), msg_buffer, msg_len);
+	__atomic_store_n(&r->tail, tail + need, __ATOMIC_RELEASE);
+
+	return;
+}
+
+// no more log of the connection
+void close_log(connection *c) {
+	__atomic_store_n(&c->log.closed, 1, __ATOMIC_RELEASE);
+
+	return;
+}
+
+// writev() all of iov, short writes continue where they stopped
+void write_all(int fd, struct iovec *iov, int n) {
+	while (n > 0){
+		ssize_t len = writev(fd, iov, n < IOV_MAX ? n : IOV_MAX);
+
+		if (len < 0){
+			if (errno == EINTR)
+				continue;
+			perror("Client : log write");
+			exit(0);
+		}
+
+		for (; n > 0 && (size_t)len >= iov->iov_len; iov++, n--)
+			len -= iov->iov_len;
+		if (n > 0){
+			iov->iov_base = (char *)iov->iov_base + len;
+			iov->iov_len -= len;
+		}
+	}
+
+	return;
+}
+
+// write up to LOG_BATCH queued records of a connection with one writev()
+//	a record is "time | msg size | msg\n", the msg is not copied out of the ring
+//	returns the number of records written
+int drain_text(log_ring *r, unsigned long head, unsigned long tail) {
+	struct iovec iov[LOG_BATCH * 4];
+	char prefix[LOG_BATCH][32];
+	int n_rec = 0, n_iov = 0;
+
+	for (; head != tail && n_rec < LOG_BATCH; n_rec++){
+		log_rec rec;
+		size_t off, first;
+
+		ring_copy_out(r, head, &rec, sizeof(rec));
+		head += sizeof(rec);
+
+		iov[n_iov].iov_base = prefix[n_rec];
+		iov[n_iov++].iov_len = sprintf(prefix[n_rec], "%s | %u | ", format_log_time(&logger.tc, rec.time), rec.len);
+
+		// msg, in two pieces if it wraps
+		off = head & (r->size - 1);
+		first = rec.len < r->size - off ? rec.len : r->size - off;
+		iov[n_iov].iov_base = r->buf + off;
+		iov[n_iov++].iov_len = first;
+		if (first < rec.len){
+			iov[n_iov].iov_base = r->buf;
+			iov[n_iov++].iov_len = rec.len - first;
+		}
+
+		iov[n_iov].iov_base = "\n";
+		iov[n_iov++].iov_len = 1;
+
+		head += rec.len;
+	}
+
+	if (n_rec > 0){
+		write_all(r->fd, iov, n_iov);
+		__atomic_store_n(&r->head, head, __ATOMIC_RELEASE);
+	}
+
+	return n_rec;
+}
+
+// write every queued record of a connection as it is in the ring : one writev(), two pieces at most
+//	returns the number of bytes written
+int drain_bin(log_ring *r, unsigned long head, unsigned long tail) {
+	struct iovec iov[2];
+	size_t len = tail - head;
+	size_t off;
+	int n_iov = 1;
+
+	// buf and size of an empty ring may be replaced by grow_log() right now,
+	// a non-empty one is fixed and was published with tail (acquired in drain_log())
+	if (len == 0)
+		return 0;
+	off = head & (r->size - 1);
+
+	iov[0].iov_base = r->buf + off;
+	iov[0].iov_len = len < r->size - off ? len : r->size - off;
+	if (iov[0].iov_len < len){
+		iov[1].iov_base = r->buf;
+		iov[1].iov_len = len - iov[0].iov_len;
+		n_iov = 2;
+	}
+
+	write_all(r->fd, iov, n_iov);
+	__atomic_store_n(&r->head, tail, __ATOMIC_RELEASE);
+
+	return len;
+}
+
+// write the queued records of a connection, returns 0 if there was none
+int drain_log(log_ring *r) {
+	unsigned long head = r->head;
+	unsigned long tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+	if (log_format == LOG_BIN)
+		return drain_bin(r, head, tail);
+
+	return drain_text(r, head, tail);
+}
+
+// logger thread : drains every log ring in turn until all are closed and empty
+void *logger_main(void *arg) {
+
+	while (1){
+		int written = 0;
+		int open_logs = 0;
+
+		for (int i = 0; i < logger.n; i++){
+			log_ring *r = &logger.conns[i].log;
+			int closed;
+
+			if (r->fd < 0)
+				continue;
+
+			closed = __atomic_load_n(&r->closed, __ATOMIC_ACQUIRE);
+			written += drain_log(r);
+
+			if (closed && r->head == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)){
+				close(r->fd);
+				free(r->buf);
+				r->fd = -1;
+			}
+			else{
+				open_logs++;
+			}
+		}
+
+		if (open_logs == 0)
+			break;
+		// nothing queued : let records pile up into bigger batches
+		if (written == 0)
+			usleep(LOG_IDLE);
+	}
+
+	return NULL;
+}
+
+// start the logger thread for the connections of a session
+void start_logger(connection *conns, int n) {
+	logger.conns = conns;
+	logger.n = n;
+	logger.tc.sec = -1;
+
+	if (pthread_create(&logger.thread, NULL, logger_main, NULL) != 0){
+		perror("Client : Can't create logger thread.");
+		exit(0);
+	}
+
+	return;
+}
+
+// wait for the logger to write the last records, every log must be closed
+void stop_logger(void) {
+	pthread_join(logger.thread, NULL);
+
+	return;
+}
+
+// Clients receive server's msg
+void *server_msg(void *arg) {
+
+	int msg_len;         		// message size
+	char msg_buffer[MAX_MSG]; 	// message buffer
+
+	connection *c = (connection *)arg;
+
+	while(1){
 		// read msg
-		//	receive msg through client_socket_fd,
+		//	receive msg through client socket,
 		//	store it in msg_buffer,
 		//	and return the length of received msg
-		msg_len = recv(client_socket_fd, msg_buffer, MAX_MSG, 0);
+		//	msg_buffer is reused as is : only msg_len bytes of it are read
+		msg_len = recv(c->fd, msg_buffer, MAX_MSG, 0);
+		if (msg_len < 0 && errno == EINTR)
+			continue;
+
+		// server closed the connection or error : nothing more to log
+		if (msg_len <= 0)
+			break;
 
-		// write log
-		//	write current time, msg size, msg to log file
-		sprintf(log_temp, "%s | %d | %s", get_current_time(), msg_len, msg_buffer);
-		fputs(log_temp, fp);
-		fputs("\n", fp);
+		write_log(c, msg_buffer, msg_len);
 
 		// check if connection finished
-		atsign_count += atsign_counting(msg_buffer, msg_len);
-		if (atsign_count >= 5){
-			fclose(fp);
-			return;
-		}
+		if (atsign_counting(c, msg_buffer, msg_len))
+			break;
 	}
 
-	fclose(fp);
+	close_log(c);
 
-	return;
+	return NULL;
 }
 
 // create threads
-void create_thread(pthread_t *p_thread, int *client_socket, int port, int log_num) {
+void create_thread(pthread_t *p_thread, connection *c) {
 
 	int thread_ID;
+	pthread_attr_t attr;
 
-	// set pthread_create args
-	p_thread_args *pThreadArgs = (p_thread_args *)malloc(sizeof(p_thread_args));
-	pThreadArgs->client_socket = client_socket;
-	pThreadArgs->port = port;
+	// small stacks : thousands of connections, thousands of threads
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, THREAD_STACK);
 
 	// create pthread : dealing with server_msg
-	thread_ID = pthread_create(p_thread, NULL, server_msg, (void *)pThreadArgs);
+	thread_ID = pthread_create(p_thread, &attr, server_msg, (void *)c);
+	pthread_attr_destroy(&attr);
 
-	// error
-	if (thread_ID < 0){
+	// error : pthread_create() returns an errno
+	if (thread_ID != 0){
+		errno = thread_ID;
 		perror("Client : Can't create thread.");
 		exit(0);
 	}
@@ -223,6 +701,504 @@ void create_thread(pthread_t *p_thread, int *client_socket, int port, int log_nu
 	return;
 }
 
+struct _epoll_pool;
+
+// an epoll thread : owns an epoll instance and a queue of ready connections
+//	the sockets registered on it are its own, but any thread of the pool may
+//	take a ready connection from the queue
+typedef struct _epoll_worker {
+	pthread_t thread;
+	struct _epoll_pool *pool;
+	int epfd;
+
+	pthread_mutex_t lock;	// protects the queue, taken by the owner and by thieves
+	connection **queue;		// ready connections, circular
+	int head, n, cap;
+}epoll_worker;
+
+// fixed pool of epoll threads
+typedef struct _epoll_pool {
+	epoll_worker workers[MAX_WORKER];
+	int n_workers;
+	int remaining;		// connections not finished yet
+}epoll_pool;
+
+// queue a ready connection
+void push_ready(epoll_worker *w, connection *c) {
+	pthread_mutex_lock(&w->lock);
+	w->queue[(w->head + w->n++) % w->cap] = c;
+	pthread_mutex_unlock(&w->lock);
+
+	return;
+}
+
+// take a ready connection : the owner from the head, thieves from the tail
+connection *pop_ready(epoll_worker *w, int steal) {
+	connection *c = NULL;
+
+	pthread_mutex_lock(&w->lock);
+	if (w->n > 0){
+		if (steal){
+			c = w->queue[(w->head + w->n - 1) % w->cap];
+		}
+		else{
+			c = w->queue[w->head];
+			w->head = (w->head + 1) % w->cap;
+		}
+		w->n--;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return c;
+}
+
+// move the ready sockets of the epoll instance to the queue
+//	sockets are EPOLLONESHOT : a ready connection is in one queue only,
+//	until it is re-armed
+int poll_ready(epoll_worker *w, int timeout) {
+	struct epoll_event events[MAX_EVENTS];
+	int n = epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+
+	if (n < 0){
+		if (errno == EINTR)
+			return 0;
+		perror("Client : epoll_wait");
+		exit(0);
+	}
+
+	for (int i = 0; i < n; i++)
+		push_ready(w, (connection *)events[i].data.ptr);
+
+	return n;
+}
+
+// take a ready connection from another thread of the pool
+connection *steal_ready(epoll_worker *w) {
+	epoll_pool *pool = w->pool;
+	int self = w - pool->workers;
+
+	for (int i = 1; i < pool->n_workers; i++){
+		connection *c = pop_ready(&pool->workers[(self + i) % pool->n_workers], 1);
+
+		if (c)
+			return c;
+	}
+
+	return NULL;
+}
+
+// remove a finished connection from its epoll instance
+void finish_connection(epoll_worker *w, connection *c) {
+	epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close_log(c);
+	__atomic_sub_fetch(&w->pool->remaining, 1, __ATOMIC_RELEASE);
+
+	return;
+}
+
+// receive up to MAX_BURST messages of a ready connection
+//	then it goes back to the tail of the queue if the socket still has data,
+//	or to its epoll instance
+void serve_connection(epoll_worker *w, connection *c, char *msg_buffer) {
+	struct epoll_event ev;
+
+	for (int i = 0; i < MAX_BURST; i++){
+		int msg_len = recv(c->fd, msg_buffer, MAX_MSG, 0);
+		if (msg_len < 0 && errno == EINTR)
+			continue;
+
+		// drained : wait for the next readiness
+		if (msg_len < 0 && errno == EAGAIN){
+			ev.events = EPOLLIN | EPOLLONESHOT;
+			ev.data.ptr = c;
+			epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+			return;
+		}
+
+		// server closed the connection or error : nothing more to log
+		if (msg_len <= 0){
+			finish_connection(w, c);
+			return;
+		}
+
+		write_log(c, msg_buffer, msg_len);
+
+		// check if connection finished
+		if (atsign_counting(c, msg_buffer, msg_len)){
+			finish_connection(w, c);
+			return;
+		}
+	}
+
+	// a chatty connection yields to the others : sockets that became ready meanwhile
+	// are queued ahead of it, or they would wait until it drains
+	poll_ready(w, 0);
+	push_ready(w, c);
+
+	return;
+}
+
+// Clients receive server's msg on the connections of the pool
+//	own ready connections first, then the epoll instance, then steal from
+//	the other threads, and only then block for a while
+void *epoll_msg(void *arg) {
+
+	epoll_worker *w = (epoll_worker *)arg;
+	char msg_buffer[MAX_MSG]; 	// message buffer, shared by the connections served by the thread
+
+	while (__atomic_load_n(&w->pool->remaining, __ATOMIC_ACQUIRE) > 0){
+		connection *c = pop_ready(w, 0);
+
+		if (!c && poll_ready(w, 0) > 0)
+			c = pop_ready(w, 0);
+		if (!c)
+			c = steal_ready(w);
+		if (!c){
+			poll_ready(w, IDLE_WAIT);
+			continue;
+		}
+
+		serve_connection(w, c, msg_buffer);
+	}
+
+	return NULL;
+}
+
+// receive on all sockets with a pool of n_workers epoll threads
+//	sockets are registered to the threads round-robin
+void run_epoll(connection *conns, int port_num, int n_workers) {
+
+	epoll_pool pool;
+
+	if (n_workers > port_num)
+		n_workers = port_num;
+
+	pool.n_workers = n_workers;
+	pool.remaining = port_num;
+
+	for (int i = 0; i < n_workers; i++){
+		epoll_worker *w = &pool.workers[i];
+
+		w->pool = &pool;
+		w->epfd = epoll_create1(0);
+		pthread_mutex_init(&w->lock, NULL);
+		// a connection is queued once at most
+		w->queue = (connection **)malloc(port_num * sizeof(connection *));
+		w->head = w->n = 0;
+		w->cap = port_num;
+
+		if (w->epfd < 0 || !w->queue){
+			perror("Client : Can't create epoll thread");
+			exit(0);
+		}
+	}
+
+	for (int i = 0; i < port_num; i++){
+		struct epoll_event ev;
+
+		conns[i].epfd = pool.workers[i % n_workers].epfd;
+
+		fcntl(conns[i].fd, F_SETFL, fcntl(conns[i].fd, F_GETFL) | O_NONBLOCK);
+
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = &conns[i];
+		if (epoll_ctl(conns[i].epfd, EPOLL_CTL_ADD, conns[i].fd, &ev) < 0){
+			perror("Client : epoll_ctl");
+			exit(0);
+		}
+	}
+
+	// create epoll threads
+	for (int i = 0; i < n_workers; i++){
+		if (pthread_create(&pool.workers[i].thread, NULL, epoll_msg, (void *)&pool.workers[i]) != 0){
+			perror("Client : Can't create thread.");
+			exit(0);
+		}
+	}
+
+	// wait epoll threads
+	for (int i = 0; i < n_workers; i++){
+		pthread_join(pool.workers[i].thread, NULL);
+		close(pool.workers[i].epfd);
+		pthread_mutex_destroy(&pool.workers[i].lock);
+		free(pool.workers[i].queue);
+	}
+
+	return;
+}
+
+// an io_uring thread : owns a ring and a provided buffer ring, handles
+//	connections idx, idx + n_workers, idx + 2 * n_workers, ... of conns
+typedef struct _uring_worker {
+	pthread_t thread;
+	connection *conns;
+	int idx, n_workers, port_num;
+	int n_conn;		// connections not finished yet
+
+	int ring_fd;
+	unsigned to_submit;		// sqes queued since the last io_uring_enter()
+
+	// submission queue
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+
+	// completion queue
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	// provided buffers : the kernel picks one per received message
+	struct io_uring_buf_ring *br;
+	char *bufs;
+	unsigned short br_tail;
+}uring_worker;
+
+int uring_enter(uring_worker *w, unsigned min_complete) {
+	int ret = syscall(__NR_io_uring_enter, w->ring_fd, w->to_submit, min_complete,
+		min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+	if (ret < 0){
+		if (errno == EINTR)
+			return 0;
+		perror("Client : io_uring_enter");
+		exit(0);
+	}
+	w->to_submit -= ret;
+
+	return ret;
+}
+
+// create the ring and register the provided buffer ring
+//	done by the thread using it : the ring is single issuer
+void uring_setup(uring_worker *w) {
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	size_t ring_size, br_size;
+	char *ring;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+	w->ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if (w->ring_fd < 0 && errno == EINVAL){
+		// kernel before 6.1
+		memset(&p, 0, sizeof(p));
+		w->ring_fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	}
+	if (w->ring_fd < 0 || !(p.features & IORING_FEAT_SINGLE_MMAP)){
+		perror("Client : io_uring_setup");
+		exit(0);
+	}
+
+	// sq and cq rings share one mapping
+	ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	if (ring_size < p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe))
+		ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, w->ring_fd, IORING_OFF_SQ_RING);
+	w->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, w->ring_fd, IORING_OFF_SQES);
+	if (ring == MAP_FAILED || w->sqes == MAP_FAILED){
+		perror("Client : io_uring mmap");
+		exit(0);
+	}
+
+	w->sq_head = (unsigned *)(ring + p.sq_off.head);
+	w->sq_tail = (unsigned *)(ring + p.sq_off.tail);
+	w->sq_mask = (unsigned *)(ring + p.sq_off.ring_mask);
+	w->sq_array = (unsigned *)(ring + p.sq_off.array);
+	w->cq_head = (unsigned *)(ring + p.cq_off.head);
+	w->cq_tail = (unsigned *)(ring + p.cq_off.tail);
+	w->cq_mask = (unsigned *)(ring + p.cq_off.ring_mask);
+	w->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+	w->to_submit = 0;
+
+	// provided buffer ring, all buffers given to the kernel
+	br_size = URING_BUFS * sizeof(struct io_uring_buf);
+	w->br = mmap(NULL, br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	w->bufs = malloc((size_t)URING_BUFS * MAX_MSG);
+	if (w->br == MAP_FAILED || !w->bufs){
+		perror("Client : io_uring buffers");
+		exit(0);
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)w->br;
+	reg.ring_entries = URING_BUFS;
+	reg.bgid = URING_BGID;
+	if (syscall(__NR_io_uring_register, w->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0){
+		perror("Client : io_uring provided buffers");
+		exit(0);
+	}
+
+	w->br_tail = 0;
+	for (int i = 0; i < URING_BUFS; i++){
+		struct io_uring_buf *b = &w->br->bufs[i];
+
+		b->addr = (unsigned long)(w->bufs + (size_t)i * MAX_MSG);
+		b->len = MAX_MSG;
+		b->bid = i;
+	}
+	w->br_tail = URING_BUFS;
+	__atomic_store_n(&w->br->tail, w->br_tail, __ATOMIC_RELEASE);
+
+	return;
+}
+
+// get a free sqe, submitting queued ones if the queue is full
+struct io_uring_sqe *uring_get_sqe(uring_worker *w) {
+	unsigned tail = *w->sq_tail;
+	struct io_uring_sqe *sqe;
+
+	while (tail - __atomic_load_n(w->sq_head, __ATOMIC_ACQUIRE) >= URING_ENTRIES)
+		uring_enter(w, 0);
+
+	sqe = &w->sqes[tail & *w->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	w->sq_array[tail & *w->sq_mask] = tail & *w->sq_mask;
+	__atomic_store_n(w->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	w->to_submit++;
+
+	return sqe;
+}
+
+// arm a multishot recv : one completion per message, into a provided buffer
+void uring_recv(uring_worker *w, connection *c) {
+	struct io_uring_sqe *sqe = uring_get_sqe(w);
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->user_data = (unsigned long)c;
+
+	return;
+}
+
+// finish a connection, its multishot recv is cancelled
+void uring_finish(uring_worker *w, connection *c) {
+	struct io_uring_sqe *sqe = uring_get_sqe(w);
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = (unsigned long)c;
+	sqe->user_data = 0;
+
+	c->done = 1;
+	close_log(c);
+	w->n_conn--;
+
+	return;
+}
+
+// give a buffer back to the kernel, published after the completion batch
+void uring_put_buf(uring_worker *w, int bid) {
+	struct io_uring_buf *b = &w->br->bufs[w->br_tail & (URING_BUFS - 1)];
+
+	b->addr = (unsigned long)(w->bufs + (size_t)bid * MAX_MSG);
+	b->len = MAX_MSG;
+	b->bid = bid;
+	w->br_tail++;
+
+	return;
+}
+
+void uring_complete(uring_worker *w, struct io_uring_cqe *cqe) {
+	connection *c = (connection *)cqe->user_data;
+	int bid = -1;
+
+	if (cqe->flags & IORING_CQE_F_BUFFER)
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+	// cancel requests and connections already finished
+	if (c && !c->done){
+		if (cqe->res > 0 && bid >= 0){
+			char *msg_buffer = w->bufs + (size_t)bid * MAX_MSG;
+
+			write_log(c, msg_buffer, cqe->res);
+
+			// check if connection finished
+			if (atsign_counting(c, msg_buffer, cqe->res))
+				uring_finish(w, c);
+		}
+		// server closed the connection or error, -ENOBUFS only stops the multishot
+		else if (cqe->res != -ENOBUFS){
+			uring_finish(w, c);
+		}
+
+		// multishot stopped (buffers ran out, ...) : arm it again
+		if (!c->done && !(cqe->flags & IORING_CQE_F_MORE))
+			uring_recv(w, c);
+	}
+
+	if (bid >= 0)
+		uring_put_buf(w, bid);
+
+	return;
+}
+
+// Clients receive server's msg on the connections of the io_uring thread
+//	completions are reaped in batches, one io_uring_enter() submits and waits
+void *uring_msg(void *arg) {
+
+	uring_worker *w = (uring_worker *)arg;
+
+	uring_setup(w);
+
+	for (int i = w->idx; i < w->port_num; i += w->n_workers){
+		uring_recv(w, &w->conns[i]);
+		w->n_conn++;
+	}
+
+	while (w->n_conn > 0){
+		unsigned head, tail;
+
+		uring_enter(w, 1);
+
+		head = *w->cq_head;
+		tail = __atomic_load_n(w->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+			uring_complete(w, &w->cqes[head & *w->cq_mask]);
+		__atomic_store_n(w->cq_head, head, __ATOMIC_RELEASE);
+
+		__atomic_store_n(&w->br->tail, w->br_tail, __ATOMIC_RELEASE);
+	}
+
+	// pending cancels and recvs go with the ring
+	close(w->ring_fd);
+	free(w->bufs);
+
+	return NULL;
+}
+
+// receive on all sockets with n_workers io_uring threads
+void run_uring(connection *conns, int port_num, int n_workers) {
+
+	uring_worker workers[MAX_WORKER];
+
+	if (n_workers > port_num)
+		n_workers = port_num;
+
+	// create io_uring threads
+	for (int i = 0; i < n_workers; i++){
+		memset(&workers[i], 0, sizeof(workers[i]));
+		workers[i].conns = conns;
+		workers[i].idx = i;
+		workers[i].n_workers = n_workers;
+		workers[i].port_num = port_num;
+
+		if (pthread_create(&workers[i].thread, NULL, uring_msg, (void *)&workers[i]) != 0){
+			perror("Client : Can't create thread.");
+			exit(0);
+		}
+	}
+
+	// wait io_uring threads
+	for (int i = 0; i < n_workers; i++){
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	return;
+}
+
 // Terminate connection
 void close_sockets(int *client_socket, int port_num) {
 	printf("Close\n");
@@ -237,58 +1213,151 @@ void close_sockets(int *client_socket, int port_num) {
 
 int main(int argc, char *argv[]) {
 
-	int client_socket[MAX_PORT];                 	// client socket
-	int ports[MAX_PORT];                  		    // port number for each sockets
+	int *client_socket = NULL;                 	    // client socket
+	int *ports = NULL;                  		    // port number for each sockets
 	char server_IP[20];                           	// server ip address
-	struct sockaddr_in client_addr[MAX_PORT]; 	    // address for each client
-	struct sockaddr_in server_addr;            	    // server address
+	int timeout = CONNECT_TIMEOUT;                  // ms allowed to connect
+	connection *conns = NULL;                       // connection and its log for each sockets
+	int max_connection = MAX_CONNECTION;            // connections allowed per ports
 
-	pthread_t p_thread[MAX_PORT]; 			        // thread
-	int status[MAX_PORT];                           // thread status
+	pthread_t *p_thread = NULL; 			        // thread
 
 	int i; 						                    // index for managing ports
 	int port_num;					                // the number of ports
 
+	int mode = MODE_THREAD;                         // receive mode
+	int n_workers = sysconf(_SC_NPROCESSORS_ONLN);  // epoll / io_uring threads
+	int opt;
+
+	// options
+	//	-m thread|epoll|uring : receive mode
+	//	-w n : the number of epoll / io_uring threads, default is the number of cores
+	//	-l bin|text : log format, bin keeps full messages (log_convert makes text of it)
+	//	-c n : connections allowed per ports, default MAX_CONNECTION
+	//	-t ms : time allowed to connect, default CONNECT_TIMEOUT
+	while ((opt = getopt(argc, argv, "m:w:l:c:t:")) != -1){
+		switch (opt){
+		case 'm':
+			if (!strcmp(optarg, "thread"))
+				mode = MODE_THREAD;
+			else if (!strcmp(optarg, "epoll"))
+				mode = MODE_EPOLL;
+			else if (!strcmp(optarg, "uring"))
+				mode = MODE_URING;
+			else
+				opt = '?';
+			break;
+		case 'w':
+			n_workers = atoi(optarg);
+			if (n_workers < 1 || n_workers > MAX_WORKER)
+				opt = '?';
+			break;
+		case 'l':
+			if (!strcmp(optarg, "bin"))
+				log_format = LOG_BIN;
+			else if (!strcmp(optarg, "text"))
+				log_format = LOG_TEXT;
+			else
+				opt = '?';
+			break;
+		case 'c':
+			max_connection = atoi(optarg);
+			if (max_connection < 1)
+				opt = '?';
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			if (timeout < 1)
+				opt = '?';
+			break;
+		}
+		if (opt == '?'){
+			fprintf(stderr, "usage : %s [-m thread|epoll|uring] [-w workers] [-l bin|text] [-c connections per port] [-t connect timeout ms]\n", argv[0]);
+			exit(1);
+		}
+	}
+	// the default follows the core count
+	if (n_workers > MAX_WORKER)
+		n_workers = MAX_WORKER;
+	if (n_workers < 1)
+		n_workers = 1;
+
+	init_clock();
+	raise_nofile();
+
 	printf("Enter server IPv4 address: ");
 	scanf("%s", server_IP);
 
 	// repeat until ctrl-c
 	while(1){
-		int idx_port_mapping[MAX_PORT] = {0,};		// to keep max connection
-		int socket_connection_num[MAX_PORT] = {0,};	// the number of connection per socket
+		port_table connection_num;		// the number of connection per port, to keep max connection
 
 		// intialize ports
-		port_num = init_ports(ports);
+		port_num = init_ports(&ports);
+
+		// tables for the sockets of the session
+		client_socket = (int *)realloc(client_socket, (port_num + 1) * sizeof(int));
+		conns = (connection *)realloc(conns, (port_num + 1) * sizeof(connection));
+		p_thread = (pthread_t *)realloc(p_thread, (port_num + 1) * sizeof(pthread_t));
+		if (!client_socket || !conns || !p_thread){
+			perror("Client : realloc");
+			exit(0);
+		}
+		port_table_init(&connection_num, PORT_TABLE);
 
 		printf("Open : ");
-		// connect each sockets to the server
+		// create each sockets
 		for (i = 0; i < port_num; i++){
 
 			// create a socket at port[i]
-			create_socket(idx_port_mapping, &client_socket[i], ports[i], socket_connection_num);
+			create_socket(&connection_num, &client_socket[i], ports[i], max_connection);
 
 			// if created, print port number
 			printf("%6d  ",ports[i]);
 
-			// initialize server information for connection
-			configure_server(&server_addr, server_IP, ports[i]);
-
-			// connect the socket to the server
-			connect_server(&server_addr, client_socket[i], ports[i]);
-
 		}
 		printf("\n");
+		port_table_free(&connection_num);
 
-		// create threads
-		for (i = 0; i < port_num; i++){
-			create_thread(&p_thread[i], &client_socket[i], ports[i], i);
+		// connect the sockets to the server, failed ones are dropped from the session
+		port_num = connect_all(server_IP, client_socket, ports, port_num, timeout);
+		if (port_num == 0){
+			printf("Client : No connection\n");
+			continue;
 		}
 
-		// wait threads
+		// initialize the connections and their logs
 		for (i = 0; i < port_num; i++){
-			pthread_join(p_thread[i], (void *)&status[i]);
+			memset(&conns[i], 0, sizeof(conns[i]));
+			conns[i].fd = client_socket[i];
+			conns[i].port = ports[i];
+			open_log(&conns[i]);
 		}
 
+		// log files are written by the logger thread only
+		start_logger(conns, port_num);
+
+		if (mode == MODE_EPOLL){
+			// a few threads for all sockets
+			run_epoll(conns, port_num, n_workers);
+		}
+		else if (mode == MODE_URING){
+			run_uring(conns, port_num, n_workers);
+		}
+		else{
+			// create threads
+			for (i = 0; i < port_num; i++){
+				create_thread(&p_thread[i], &conns[i]);
+			}
+
+			// wait threads
+			for (i = 0; i < port_num; i++){
+				pthread_join(p_thread[i], NULL);
+			}
+		}
+
+		stop_logger();
+
 		// close sockets
 		close_sockets(client_socket, port_num);
 	}
@@ -0,0 +1,141 @@
+/*
+ * binary client log -> text log
+ *	each record becomes a "time | msg size | msg" line, as the client writes with -l text.
+ *	a record cut by a killed client ends the conversion of its file.
+ *
+ * usage : log_convert [-c] log.bin...
+ *	writes log.txt next to each log.bin, -c : to stdout
+ *
+ * build : gcc -O2 -o log_convert log_convert.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log_format.h"
+
+// 1 if the mapped file starts like a binary log
+static int is_bin_log(const char *base, size_t len) {
+	return len >= LOG_MAGIC_LEN && !memcmp(base, LOG_MAGIC, LOG_MAGIC_LEN);
+}
+
+// convert one mapped binary log, returns records converted
+static long convert(const char *base, size_t len, FILE *out) {
+	const char *p = base + LOG_MAGIC_LEN;
+	const char *end = base + len;
+	time_cache tc = { -1, "" };
+	long n = 0;
+
+	while (p + sizeof(log_rec) <= end){
+		log_rec rec;
+
+		memcpy(&rec, p, sizeof(rec));
+		if (rec.len > (size_t)(end - p) - sizeof(rec)){
+			fprintf(stderr, "log_convert : truncated record at offset %ld\n", (long)(p - base));
+			break;
+		}
+		p += sizeof(rec);
+
+		fprintf(out, "%s | %u | ", format_log_time(&tc, rec.time), rec.len);
+		fwrite(p, 1, rec.len, out);
+		putc('\n', out);
+
+		p += rec.len;
+		n++;
+	}
+
+	return n;
+}
+
+static int convert_file(const char *path, int to_stdout) {
+	struct stat st;
+	char *base, *out_path = NULL;
+	FILE *out = stdout;
+	long n;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0){
+		perror(path);
+		return -1;
+	}
+	if (st.st_size == 0){
+		fprintf(stderr, "log_convert : %s is empty\n", path);
+		close(fd);
+		return -1;
+	}
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED){
+		perror(path);
+		return -1;
+	}
+	madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+	// check before the output is created : a text log must not leave an empty .txt behind
+	if (!is_bin_log(base, st.st_size)){
+		fprintf(stderr, "log_convert : %s is not a binary client log\n", path);
+		munmap(base, st.st_size);
+		return -1;
+	}
+
+	if (!to_stdout){
+		// log/1111_3.bin -> log/1111_3.txt
+		size_t len = strlen(path);
+		const char *ext = len > 4 && !strcmp(path + len - 4, ".bin") ? path + len - 4 : path + len;
+
+		out_path = malloc(len + 5);
+		sprintf(out_path, "%.*s.txt", (int)(ext - path), path);
+		out = fopen(out_path, "w");
+		if (!out){
+			perror(out_path);
+			free(out_path);
+			munmap(base, st.st_size);
+			return -1;
+		}
+	}
+
+	n = convert(base, st.st_size, out);
+	if (!to_stdout)
+		fprintf(stderr, "log_convert : %s -> %s, %ld records\n", path, out_path, n);
+
+	if (!to_stdout)
+		fclose(out);
+	free(out_path);
+	munmap(base, st.st_size);
+
+	return 0;
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage : log_convert [-c] log.bin...\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	int opt, to_stdout = 0, ret = 0;
+
+	while ((opt = getopt(argc, argv, "c")) != -1){
+		switch (opt){
+		case 'c':
+			to_stdout = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind == argc)
+		usage();
+
+	for (int i = optind; i < argc; i++)
+		if (convert_file(argv[i], to_stdout) < 0)
+			ret = 1;
+
+	return ret;
+}
@@ -0,0 +1,50 @@
+/*
+ * binary message log of the client
+ *	full messages with their receive time, written by the logger thread as they sit in its queues
+ *
+ *	file : LOG_MAGIC | record | record | ...
+ *	record : log_rec | msg (len bytes), host byte order
+ *
+ *	log_convert turns it into the text log, "time | msg size | msg" per record.
+ */
+
+#ifndef _LOG_FORMAT_H
+#define _LOG_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOG_MAGIC "SPCLOG1\n"
+#define LOG_MAGIC_LEN 8
+
+typedef struct _log_rec {
+	uint64_t time;		// receive time, us since the epoch
+	uint32_t conn;		// connection id : socket fd, as in the log file name
+	uint32_t len;		// msg size
+}log_rec;
+
+// last second formatted by format_log_time()
+typedef struct _time_cache {
+	time_t sec;			// -1 : empty
+	char s[16];			// "HH:MM:SS.mmm"
+}time_cache;
+
+// HH:MM:SS.mmm of a log time
+//	localtime() runs once per second of log, the cache belongs to the formatting thread
+static inline const char *format_log_time(time_cache *tc, uint64_t time) {
+	time_t sec = time / 1000000;
+
+	if (sec != tc->sec){
+		struct tm lt;
+
+		localtime_r(&sec, &lt);
+		sprintf(tc->s, "%02d:%02d:%02d.", lt.tm_hour, lt.tm_min, lt.tm_sec);
+		tc->sec = sec;
+	}
+	sprintf(tc->s + 9, "%03d", (int)(time % 1000000 / 1000));
+
+	return tc->s;
+}
+
+#endif